@@ -0,0 +1,504 @@
+/*
+ * SCANDINOVA vacuum auto drive algorithm
+ *
+ * The decision logic only talks to the outside world through
+ * SCANDINOVA_AUTO_DRIVE_OPS, so the same code runs in the IOC (wall clock,
+ * dbpf commands) and in scandinovaSim (virtual clock, modulator model).
+ * Blocking/decrease times are kept as hold deadlines instead of sleeps,
+ * autoDriveProcess() is called once per second by its owner.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "devSCANDINOVA.h"
+
+#define AD_RESET_HV				300.0		// hv of an interlock reset (unit: v)
+
+static void holdState(SCANDINOVA_AUTO_DRIVE_INFO *p, int nState, double dbNow, double dbTime)
+{
+	p->nState = nState;
+	p->dbHoldUntil = dbNow + dbTime;
+}
+
+static void commandHv(SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_AUTO_DRIVE_OPS *pOps, double dbSetpoint)
+{
+	p->dbCommandedHv = dbSetpoint;
+	p->dbSettleStart = -1;
+	p->bSettled = 0;
+	p->dbCommandTime = pOps->getTime(pOps->pPvt);
+	pOps->setHv(pOps->pPvt, p->nParentId, dbSetpoint);
+}
+
+/*
+ * Write verification of the hv setpoint (SDN_VERIFY_IDLE without it, as in
+ * scandinovaSim): the last command of this channel is in a ping frame.
+ */
+static int hvApplied(const SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_INFO *pInfo)
+{
+	const SCANDINOVA_VERIFY_INFO *pVfy = &pInfo->VFY[SDN_VERIFY_HV];
+
+	return pVfy->nStatus == SDN_VERIFY_APPLIED && pVfy->dbFirstSent >= p->dbCommandTime
+			&& fabs(pVfy->dbValue - p->dbCommandedHv) <= SDN_VERIFY_HV_TOLERANCE;
+}
+
+/*
+ * Hv on after an interlock reset only from the reset voltage: the 300 v
+ * command is applied, or the modulator already reports it as its setpoint.
+ */
+static int resetHvReached(const SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_INFO *pInfo)
+{
+	return hvApplied(p, pInfo) || fabs(pInfo->dbHVPSVoltSet - AD_RESET_HV) <= SDN_VERIFY_HV_TOLERANCE;
+}
+
+void autoDriveSetDefaults(SCANDINOVA_AUTO_DRIVE_INFO *p, int nDevIdx, int nIdx)
+{
+	memset(p,0x00,sizeof(SCANDINOVA_AUTO_DRIVE_INFO));
+
+	if(nIdx==0)
+	{
+		p->bUse = 1;
+		p->dbTripHighLimit = 5.2;
+		p->dbAlarmHighLimit = 4.8;
+		p->dbAlarmLowLimit = 3.6;
+		p->dbTripLowLimit = 3.5;
+		p->dbHVRampSpeed = 1; // voltage
+		p->dbHVRampCheckTime = 60; // second
+		p->dbHVMaxPoint = 1290.0;
+
+		p->dbTripBlockingTime = 300;
+		p->dbAlarmBlockingTime = 30;
+		p->dbAlarmDecreaseTime = 300;		// (unit: sec)
+
+		p->dbHVTripGain = 90;		// percent
+		p->dbHVAlarmGain = 100;	// percent
+
+		p->nPriority = MASTER;
+
+		p->bSettleUse = 1;
+		p->dbSettleTolerance = 2;	// voltage
+		p->dbSettleWindow = 3;		// second
+		p->dbSettleVacuumBand = 0.05;
+
+		p->nRampMode = AD_RAMP_FIXED;
+		p->dbAdaptSpeedMin = 0.5;	// voltage
+		p->dbAdaptSpeedMax = 5;	// voltage
+		p->dbAdaptHeadroomGain = 1.5;
+		p->dbAdaptArcGain = 0.5;
+		p->dbAdaptArcTau = 30;		// second
+	}
+	else
+	{
+		p->nPriority = SLAVE;
+		p->bUse = 0;
+	}
+
+	p->dbStaleLimit = 5;			// second
+
+	p->nIdx = nIdx;
+	p->nParentId = nDevIdx;
+	p->dbSettleStart = -1;
+	p->dbCommandedHv = -1;
+	p->dbAdaptLastSample = -1;
+}
+
+// tunable parameters by name: -p/-s of scandinovaSim, the shadow overrides
+const SCANDINOVA_PARAM_DEF autoDriveParams[] = {
+	{"TripHighLimit",		offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbTripHighLimit),		0},
+	{"AlarmHighLimit",		offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbAlarmHighLimit),		0},
+	{"AlarmLowLimit",		offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbAlarmLowLimit),		0},
+	{"TripLowLimit",		offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbTripLowLimit),		0},
+	{"HVRampSpeed",			offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbHVRampSpeed),			0},
+	{"HVRampCheckTime",		offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbHVRampCheckTime),		0},
+	{"HVMaxPoint",			offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbHVMaxPoint),			0},
+	{"TripBlockingTime",	offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbTripBlockingTime),	0},
+	{"AlarmBlockingTime",	offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbAlarmBlockingTime),	0},
+	{"AlarmDecreaseTime",	offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbAlarmDecreaseTime),	0},
+	{"HVTripGain",			offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbHVTripGain),			0},
+	{"HVAlarmGain",			offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbHVAlarmGain),			0},
+	{"SettleUse",			offsetof(SCANDINOVA_AUTO_DRIVE_INFO,bSettleUse),			1},
+	{"SettleTolerance",		offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbSettleTolerance),		0},
+	{"SettleWindow",		offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbSettleWindow),		0},
+	{"SettleVacuumBand",	offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbSettleVacuumBand),	0},
+	{"RampMode",			offsetof(SCANDINOVA_AUTO_DRIVE_INFO,nRampMode),				1},
+	{"AdaptSpeedMin",		offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbAdaptSpeedMin),		0},
+	{"AdaptSpeedMax",		offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbAdaptSpeedMax),		0},
+	{"AdaptHeadroomGain",	offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbAdaptHeadroomGain),	0},
+	{"AdaptArcGain",		offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbAdaptArcGain),		0},
+	{"AdaptArcTau",			offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbAdaptArcTau),			0},
+	{"StaleLimit",			offsetof(SCANDINOVA_AUTO_DRIVE_INFO,dbStaleLimit),			0},
+	{NULL, 0, 0}
+};
+
+// nLen: name need not be terminated, -1: unknown
+int autoDriveFindParam(const SCANDINOVA_PARAM_DEF *pTable, const char *name, size_t nLen)
+{
+	int i;
+
+	for(i=0;pTable[i].name;++i)
+		if(strlen(pTable[i].name) == nLen && strncmp(pTable[i].name,name,nLen) == 0)
+			return i;
+	return -1;
+}
+
+void autoDriveSetParam(const SCANDINOVA_PARAM_DEF *pParam, void *pBase, double dbVal)
+{
+	if(pParam->bInt)
+		*(int*)((char*)pBase + pParam->offset) = (int)dbVal;
+	else
+		*(double*)((char*)pBase + pParam->offset) = dbVal;
+}
+
+void autoDriveStart(SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_AUTO_DRIVE_OPS *pOps)
+{
+	double dbNow = pOps->getTime(pOps->pPvt);
+
+	p->dbLastIncrease = dbNow;
+	holdState(p, AD_STATE_STARTUP, dbNow, 0);
+}
+
+/*
+ * A step is settled once the modulator reports
+ * the commanded setpoint, the readback tracks it within dbSettleTolerance and
+ * neither the vacuum (within dbSettleVacuumBand) nor the arc rate went up
+ * for dbSettleWindow seconds.
+ */
+static void settleSample(SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_AD_SAMPLE *pSmp)
+{
+	// taken before the last command, says nothing about that step
+	if(pSmp->dbTime < p->dbCommandTime)
+		return;
+
+	if((p->dbCommandedHv >= 0 && fabs(pSmp->dbHvSet - p->dbCommandedHv) > p->dbSettleTolerance)
+			|| fabs(pSmp->dbHvRead - pSmp->dbHvSet) > p->dbSettleTolerance)
+	{
+		p->dbSettleStart = -1;
+		p->bSettled = 0;
+		return;
+	}
+
+	if(p->dbSettleStart < 0
+			|| fabs(pSmp->dbVacuum - p->dbSettleVacuumRef) > p->dbSettleVacuumBand
+			|| pSmp->dbArc > p->dbSettleArcRef)
+	{
+		p->dbSettleStart = pSmp->dbTime;
+		p->dbSettleVacuumRef = pSmp->dbVacuum;
+		p->dbSettleArcRef = pSmp->dbArc;
+		p->bSettled = 0;
+		return;
+	}
+
+	if(pSmp->dbTime - p->dbSettleStart >= p->dbSettleWindow)
+		p->bSettled = 1;
+}
+
+/*
+ * Adaptive ramp: the hv step shrinks from dbAdaptSpeedMax towards
+ * dbAdaptSpeedMin as the vacuum approaches dbAlarmHighLimit and as the
+ * filtered arc rate goes up, so the ramp slows down before a threshold is
+ * hit instead of after.
+ */
+static void adaptSample(SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_AD_SAMPLE *pSmp)
+{
+	double dbAlpha;
+	double dbHeadroom;
+	double dbFactor;
+
+	if(p->dbAdaptLastSample < 0 || p->dbAdaptArcTau <= 0)
+		p->dbArcRateFilt = pSmp->dbArc;
+	else if(pSmp->dbTime > p->dbAdaptLastSample)
+	{
+		dbAlpha = 1.0 - exp(-(pSmp->dbTime - p->dbAdaptLastSample) / p->dbAdaptArcTau);
+		p->dbArcRateFilt += dbAlpha * (pSmp->dbArc - p->dbArcRateFilt);
+	}
+	p->dbAdaptLastSample = pSmp->dbTime;
+
+	if(p->dbAlarmHighLimit > p->dbTripLowLimit)
+		dbHeadroom = (p->dbAlarmHighLimit - pSmp->dbVacuum) / (p->dbAlarmHighLimit - p->dbTripLowLimit);
+	else
+		dbHeadroom = 0;
+	dbHeadroom = fmin(fmax(dbHeadroom,0.0),1.0);
+
+	dbFactor = p->dbAdaptHeadroomGain * dbHeadroom - p->dbAdaptArcGain * p->dbArcRateFilt;
+	dbFactor = fmin(fmax(dbFactor,0.0),1.0);
+	p->dbAdaptSpeed = p->dbAdaptSpeedMin + (p->dbAdaptSpeedMax - p->dbAdaptSpeedMin) * dbFactor;
+}
+
+// values of a decoded ping, only read: the port thread takes it for the auto drive thread
+void autoDriveTakeSample(const SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_INFO *pInfo, double dbNow,
+		SCANDINOVA_AD_SAMPLE *pSmp)
+{
+	pSmp->dbTime = dbNow;
+	pSmp->dbHvSet = pInfo->dbHVPSVoltSet;
+	pSmp->dbHvRead = pInfo->dbHVPSVoltRead;
+	pSmp->dbArc = pInfo->dbCtArcPerSecondRead + pInfo->dbCvdArcPerSecondRead;
+	pSmp->dbVacuum = p->dbVacuum ? *p->dbVacuum : 0;
+}
+
+// every ping sample in order, by the owner of the channel before its autoDriveProcess()
+void autoDriveSample(SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_AD_SAMPLE *pSmp)
+{
+	if(p->bUse == 0 || p->nPriority == SLAVE)
+		return;
+
+	settleSample(p, pSmp);
+	adaptSample(p, pSmp);
+}
+
+/*
+ * Trip/alarm high comparison on a fresh vacuum sample, called by the port
+ * thread right after ping 1 was decoded. Only crossings are reported; the
+ * latch belongs to the caller, the channel itself is only read.
+ */
+int autoDriveFastCheck(const SCANDINOVA_AUTO_DRIVE_INFO *p, SCANDINOVA_FAST_LATCH *pLatch)
+{
+	int nRet = AD_FAST_NONE;
+
+	if(p->bUse == 0)
+		return AD_FAST_NONE;
+
+	if(*p->dbVacuum >= p->dbTripHighLimit)
+	{
+		if(pLatch->bTrip == 0)
+		{
+			pLatch->bTrip = 1;
+			nRet = AD_FAST_TRIP;
+		}
+	}
+	else
+		pLatch->bTrip = 0;
+
+	if(*p->dbVacuum >= p->dbAlarmHighLimit)
+	{
+		if(pLatch->bAlarm == 0)
+		{
+			pLatch->bAlarm = 1;
+			if(nRet == AD_FAST_NONE)
+				nRet = AD_FAST_ALARM;
+		}
+	}
+	else
+		pLatch->bAlarm = 0;
+
+	return nRet;
+}
+
+/*
+ * A trip crossing of the fast path, applied by the owner of the channel
+ * before its next autoDriveProcess(): the arcing state is latched with the hv
+ * read back at the crossing so the slow loop continues from it.
+ */
+void autoDriveFastTrip(SCANDINOVA_AUTO_DRIVE_INFO *p, double dbHvRead)
+{
+	p->bFastTrip = 1;
+	if(p->bOnArcing == 0)
+	{
+		p->bOnArcing = 1;
+		p->bOnMidPoint = 1;
+		p->dbMidPoint = dbHvRead * p->dbHVTripGain / 100.0;
+	}
+}
+
+// age of the oldest page the auto drive depends on (ping 0: state/hv, ping 1: vacuum)
+static double dataAge(const SCANDINOVA_INFO *pInfo, double dbNow)
+{
+	double dbOldest = pInfo->dbPageTime[0] < pInfo->dbPageTime[1] ? pInfo->dbPageTime[0] : pInfo->dbPageTime[1];
+
+	return dbNow - dbOldest;
+}
+
+void autoDriveProcess(SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_AUTO_DRIVE_OPS *pOps)
+{
+	double dbTemp;
+	double dbNow;
+	int bResetDone = 0;
+	SCANDINOVA_INFO *pInfo = pOps->getInfo(pOps->pPvt, p->nParentId);
+
+	dbNow = pOps->getTime(pOps->pPvt);
+
+	// the 300v of an interlock reset is confirmed, no need to wait out the hold
+	if(p->nState != AD_STATE_RUN && dbNow < p->dbHoldUntil
+			&& (p->nState != AD_STATE_RESET_HV || resetHvReached(p, pInfo) == 0))
+		return;
+
+	// stale data: freeze, a pending hold continues once the data is fresh again
+	if(dataAge(pInfo, dbNow) > p->dbStaleLimit)
+	{
+		if(p->bStale == 0)
+		{
+			p->bStale = 1;
+			if(p->bUse && p->bStaleStandby && (int)pInfo->dbStateRead == 0xD000)
+				pOps->changeMode(pOps->pPvt, p->nParentId, 0x0A000);
+		}
+		return;
+	}
+	p->bStale = 0;
+	if(*p->dbVacuum < p->dbTripHighLimit)
+		p->bFastTrip = 0;
+
+	// pending hold: continue where the algorithm stopped
+	if(p->nState != AD_STATE_RUN)
+	{
+
+		switch(p->nState)
+		{
+			case AD_STATE_STARTUP:			// no action before valid data exists
+				if(pInfo->bReady == 0)
+					return;
+				p->nState = AD_STATE_RUN;
+				break;
+			case AD_STATE_RESET_BLOCK:
+				pOps->hwControlSet(pOps->pPvt, p->nParentId, 0x0001);
+				holdState(p, AD_STATE_RESET_WAIT, dbNow, 5);
+				return;
+			case AD_STATE_RESET_WAIT:
+				if((int)pInfo->dbStateRead == 0x06000)
+				{
+					commandHv(p, pOps, AD_RESET_HV);
+					holdState(p, AD_STATE_RESET_HV, dbNow, 5);
+					return;
+				}
+				p->nState = AD_STATE_RUN;
+				bResetDone = 1;
+				break;
+			case AD_STATE_RESET_HV:
+				// never hv on near the pre-trip setpoint: command the 300 v again
+				if(resetHvReached(p, pInfo) == 0)
+				{
+					commandHv(p, pOps, AD_RESET_HV);
+					holdState(p, AD_STATE_RESET_HV, dbNow, 5);
+					return;
+				}
+				pOps->changeMode(pOps->pPvt, p->nParentId, 0x0D000);
+				p->nState = AD_STATE_RUN;
+				bResetDone = 1;
+				break;
+			case AD_STATE_ALARM_DECREASE:
+				p->bOnAlarm = 1;
+				p->nState = AD_STATE_RUN;
+				return;
+			case AD_STATE_ALARM_BLOCK:
+				p->bOnAlarm = 0;
+				p->nState = AD_STATE_RUN;
+				if(p->bOnArcing == 0)
+					increaseHv(p, pOps);
+				return;
+			case AD_STATE_MIDPOINT_BLOCK:
+				p->bOnMidPoint = 0;
+				p->nState = AD_STATE_RUN;
+				return;
+		}
+	}
+
+	if(p->bUse == 0)
+		return;
+
+	// hardware interlock reset
+	if(bResetDone == 0 && (int)pInfo->dbStateRead != 0xD000)
+	{
+		holdState(p, AD_STATE_RESET_BLOCK, dbNow, p->dbTripBlockingTime);
+		return;
+	}
+
+	if(*p->dbVacuum>=p->dbTripHighLimit)			// no.3 section (trip high limit)
+	{
+		p->bOnArcing = 1;
+		p->bOnMidPoint = 1;
+		if(p->bFastTrip == 0)					// else latched by the fast path already
+			p->dbMidPoint = pInfo->dbHVPSVoltRead * p->dbHVTripGain / 100.0;
+		pOps->changeMode(pOps->pPvt, p->nParentId, 0x0A000);
+	}
+	else if(*p->dbVacuum >= p->dbAlarmHighLimit)	// no.1 section (s/w alarm high limit)
+	{
+		dbTemp = pInfo->dbHVPSVoltRead * p->dbHVAlarmGain / 100.0;
+		commandHv(p, pOps, dbTemp);
+		holdState(p, AD_STATE_ALARM_DECREASE, dbNow, p->dbAlarmDecreaseTime);
+	}
+	else if(*p->dbVacuum >= p->dbAlarmLowLimit)		// normal section
+	{
+		if(p->bOnArcing == 0 && p->bOnAlarm == 0)
+			increaseHv(p, pOps);
+	}
+	else if(*p->dbVacuum >= p->dbTripLowLimit)		// no.2 section (s/w alarm low limit)
+	{
+		if(p->bOnAlarm == 1)
+		{
+			holdState(p, AD_STATE_ALARM_BLOCK, dbNow, p->dbAlarmBlockingTime);
+			return;
+		}
+		if(p->bOnArcing == 0)
+			increaseHv(p, pOps);
+	}
+	else											// no.4 section (h/w trip low limit)
+	{
+		if(p->bOnArcing == 1)
+		{
+			p->bOnArcing = 0;
+			pOps->changeMode(pOps->pPvt, p->nParentId, 0x0d000);
+		}
+		increaseHv(p, pOps);
+	}
+}
+
+int increaseHv(SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_AUTO_DRIVE_OPS *pOps)
+{
+	double dbOffset;
+	double dbSub;
+	double dbStep;
+	double dbCheckTime;
+	double dbLimit;
+	double dbTarget;
+	double dbNow;
+	SCANDINOVA_INFO *pInfo;
+
+	// only master
+	if(p->nPriority == SLAVE)
+		return 1;
+
+	pInfo = pOps->getInfo(pOps->pPvt, p->nParentId);
+	dbOffset = p->dbSettleTolerance;
+
+	// no new step on top of a setpoint the modulator has not shown yet
+	if(pInfo->VFY[SDN_VERIFY_HV].nStatus == SDN_VERIFY_PENDING)
+		return 1;
+
+	// below 1000v: +10v every 10 sec, above: +dbHVRampSpeed every dbHVRampCheckTime
+	if(pInfo->dbHVPSVoltRead <= 1000)
+	{
+		dbStep = 10.0;
+		dbCheckTime = 10.0;
+	}
+	else
+	{
+		dbStep = p->dbHVRampSpeed;
+		dbCheckTime = p->dbHVRampCheckTime;
+	}
+	if(p->nRampMode == AD_RAMP_ADAPTIVE)
+		dbStep = p->dbAdaptSpeed;
+	dbLimit = p->bOnMidPoint == 1 ? p->dbMidPoint : p->dbHVMaxPoint;
+
+	// time check, dbCheckTime is only the upper bound once settle detection is on
+	dbNow = pOps->getTime(pOps->pPvt);
+	dbSub = dbNow - p->dbLastIncrease;
+	if((dbSub >= dbCheckTime || (p->bSettleUse && p->bSettled))
+			&& dbStep > 0
+			&& pInfo->dbHVPSVoltRead >= pInfo->dbHVPSVoltSet-dbOffset
+			&& pInfo->dbHVPSVoltRead < dbLimit-dbOffset)
+	{
+		dbTarget = fmin(pInfo->dbHVPSVoltSet + dbStep,p->dbHVMaxPoint);
+		// station group budget, a deferred step is asked for again next time
+		if(pOps->grantStep && pOps->grantStep(pOps->pPvt, p->nParentId, p->nIdx, pInfo->dbHVPSVoltSet, dbTarget) == 0)
+			return 1;
+		commandHv(p, pOps, dbTarget);
+		p->dbLastIncrease = dbNow;
+	}
+	else if(p->bOnMidPoint == 1)
+	{
+		holdState(p, AD_STATE_MIDPOINT_BLOCK, dbNow, p->dbTripBlockingTime);
+	}
+
+	return 1;
+}
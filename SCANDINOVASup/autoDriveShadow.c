@@ -0,0 +1,237 @@
+/*
+ * SCANDINOVA shadow auto drive
+ *
+ * A shadow forks the decision state of a live auto drive channel, applies
+ * its own parameter overrides and then runs autoDriveProcess on the same
+ * live samples, called by the auto drive thread of that channel. Its ops
+ * never reach the modulator: the hv setpoint and the state word are kept in
+ * the shadow and written into its copy of the live SCANDINOVA_INFO, so the
+ * shadow sees its own hv trajectory next to the live vacuum and arc rates.
+ * The vacuum does not respond to the shadow hv, a shadow runs ahead of the
+ * live one as long as the live vacuum allows it. A hardware fault of the
+ * modulator trips every shadow as well. No EPICS dependency.
+ *
+ *   autoDriveShadowConfigure(pShd, 0, "HVRampSpeed=2 HVRampCheckTime=30")
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "devSCANDINOVA.h"
+
+#define MODE_HV_ON			0x0D000
+#define MODE_STANDBY		0x0A000
+#define MODE_READY			0x06000
+#define MODE_FAULT			0x0F000
+
+/******************************************************************************
+ * Recording ops, the shadow is its own modulator
+ *****************************************************************************/
+static double shadowGetTime(void *pPvt)
+{
+	return ((SCANDINOVA_SHADOW_INFO*)pPvt)->dbNow;
+}
+static SCANDINOVA_INFO *shadowGetInfo(void *pPvt, int nDevIdx)
+{
+	return &((SCANDINOVA_SHADOW_INFO*)pPvt)->view;
+}
+static int shadowChangeMode(void *pPvt, int nDevIdx, int nMode)
+{
+	SCANDINOVA_SHADOW_INFO *pShd = (SCANDINOVA_SHADOW_INFO*)pPvt;
+
+	if(nMode == MODE_STANDBY && pShd->nMode == MODE_HV_ON)
+		++pShd->nTrips;
+	if(pShd->nMode != MODE_FAULT)
+		pShd->nMode = nMode;
+	pShd->view.dbStateRead = pShd->nMode;
+	return 1;
+}
+static int shadowSetHv(void *pPvt, int nDevIdx, double dbSetpoint)
+{
+	SCANDINOVA_SHADOW_INFO *pShd = (SCANDINOVA_SHADOW_INFO*)pPvt;
+
+	if(dbSetpoint > pShd->dbHvSet && pShd->nMode == MODE_HV_ON)
+		++pShd->nSteps;
+	pShd->dbHvSet = dbSetpoint;
+	pShd->view.dbHVPSVoltSet = dbSetpoint;
+	pShd->view.dbHVPSVoltRead = dbSetpoint;
+	pShd->hvVfy.nStatus = SDN_VERIFY_APPLIED;
+	pShd->hvVfy.dbValue = dbSetpoint;
+	pShd->hvVfy.dbFirstSent = pShd->dbNow;
+	pShd->hvVfy.dbLastSent = pShd->dbNow;
+	pShd->view.VFY[SDN_VERIFY_HV] = pShd->hvVfy;
+	return 1;
+}
+static int shadowHwControlSet(void *pPvt, int nDevIdx, int nMode)
+{
+	SCANDINOVA_SHADOW_INFO *pShd = (SCANDINOVA_SHADOW_INFO*)pPvt;
+
+	if((nMode & 0x0001) && pShd->nMode == MODE_FAULT)
+		pShd->nMode = MODE_READY;
+	pShd->view.dbStateRead = pShd->nMode;
+	return 1;
+}
+
+// no station group budget, a shadow does not take grants from the live channels
+static const SCANDINOVA_AUTO_DRIVE_OPS shadowOpsTemplate = {
+	shadowGetTime, shadowGetInfo, shadowChangeMode, shadowSetHv, shadowHwControlSet, NULL, NULL
+};
+
+/******************************************************************************
+ * Configuration
+ *****************************************************************************/
+/*
+ * strParams: "name=value" separated by blanks or commas, NULL or "": the
+ * parameters of the source. The shadow forks again on the next process.
+ */
+int autoDriveShadowConfigure(SCANDINOVA_SHADOW_INFO *pShd, int nSource, const char *strParams)
+{
+	const char *p = strParams ? strParams : "";
+	const char *eq;
+	char *end;
+	size_t nLen;
+	int nParams = 0;
+	int nParam[SDN_SHADOW_MAX_PARAMS];
+	double dbParam[SDN_SHADOW_MAX_PARAMS];
+
+	if(nSource < 0 || nSource >= MAX_SCANDINOVA_VACUUM_COUNT)
+		return -1;
+
+	while(1)
+	{
+		while(*p == ' ' || *p == '\t' || *p == ',')
+			++p;
+		if(*p == '\0')
+			break;
+		nLen = strcspn(p," \t,");
+		eq = memchr(p,'=',nLen);
+		if(eq == NULL || nParams == SDN_SHADOW_MAX_PARAMS || (nParam[nParams] = autoDriveFindParam(autoDriveParams,p,eq-p)) < 0)
+			return -1;
+		dbParam[nParams] = strtod(eq+1,&end);
+		if(end != p + nLen || end == eq+1)
+			return -1;
+		++nParams;
+		p += nLen;
+	}
+
+	pShd->bUse = 0;
+	pShd->nSource = nSource;
+	memcpy(pShd->nParam,nParam,sizeof(int)*nParams);
+	memcpy(pShd->dbParam,dbParam,sizeof(double)*nParams);
+	pShd->nParams = nParams;
+	pShd->bStarted = 0;
+	pShd->bUse = 1;
+	return 0;
+}
+
+/******************************************************************************
+ * Evaluation
+ *****************************************************************************/
+static void applyParams(SCANDINOVA_SHADOW_INFO *pShd)
+{
+	int i;
+
+	for(i=0;i!=pShd->nParams;++i)
+		autoDriveSetParam(&autoDriveParams[pShd->nParam[i]],&pShd->sadi,pShd->dbParam[i]);
+}
+
+// decision state of the source as it is now, the shadow parameters on top
+static void forkShadow(SCANDINOVA_SHADOW_INFO *pShd, const SCANDINOVA_AUTO_DRIVE_INFO *pSrc,
+		const SCANDINOVA_INFO *pLive, double dbNow)
+{
+	pShd->sadi = *pSrc;
+	applyParams(pShd);
+	pShd->sadi.bUse = 1;
+	pShd->sadi.nPriority = MASTER;
+
+	memset(&pShd->hvVfy,0,sizeof(SCANDINOVA_VERIFY_INFO));
+	pShd->dbHvSet = pLive->dbHVPSVoltSet;
+	pShd->nMode = (int)pLive->dbStateRead;
+	pShd->nLiveState = pShd->nMode;
+
+	pShd->dbStart = dbNow;
+	pShd->dbLastProcess = dbNow;
+	pShd->dbHvStart = pShd->dbHvSet;
+	pShd->dbLiveHvStart = pLive->dbHVPSVoltSet;
+	pShd->nSteps = 0;
+	pShd->nTrips = 0;
+	pShd->nAlarms = 0;
+	pShd->dbHoldTime = 0;
+	pShd->dbTimeToMax = -1;
+	pShd->dbLiveTimeToMax = -1;
+	pShd->bStarted = 1;
+}
+
+// the live sample with the shadow hv, state word and hv write status
+static void refreshView(SCANDINOVA_SHADOW_INFO *pShd, const SCANDINOVA_AUTO_DRIVE_INFO *pSrc, const SCANDINOVA_INFO *pLive)
+{
+	const char *pVacuum = (const char *)pSrc->dbVacuum;
+
+	memcpy(&pShd->view,pLive,sizeof(SCANDINOVA_INFO));
+	pShd->view.dbHVPSVoltSet = pShd->dbHvSet;
+	pShd->view.dbHVPSVoltRead = pShd->dbHvSet;
+	pShd->view.dbStateRead = pShd->nMode;
+	pShd->view.VFY[SDN_VERIFY_HV] = pShd->hvVfy;
+
+	// the vacuum of the source, read from the same copy
+	if(pVacuum >= (const char *)pLive && pVacuum < (const char *)(pLive + 1))
+		pShd->sadi.dbVacuum = (double *)((char *)&pShd->view + (pVacuum - (const char *)pLive));
+	else
+		pShd->sadi.dbVacuum = pSrc->dbVacuum;
+}
+
+static double timeToMax(double dbHv, double dbHvStart, double dbElapsed, double dbMax)
+{
+	if(dbHv >= dbMax - SDN_SHADOW_AT_MAX)
+		return 0;
+	if(dbElapsed <= 0 || dbHv <= dbHvStart)
+		return -1;
+	return (dbMax - dbHv) * dbElapsed / (dbHv - dbHvStart);
+}
+
+/*
+ * One auto drive period of a shadow, right after autoDriveProcess of its
+ * source channel in the same thread.
+ */
+void autoDriveShadowProcess(SCANDINOVA_SHADOW_INFO *pShd, const SCANDINOVA_AUTO_DRIVE_INFO *pSrc,
+		const SCANDINOVA_INFO *pLive, double dbNow)
+{
+	SCANDINOVA_AUTO_DRIVE_OPS ops = shadowOpsTemplate;
+	SCANDINOVA_AD_SAMPLE smp;
+	int nLiveState;
+	int nPrevState;
+
+	if(pShd->bUse == 0)
+		return;
+
+	ops.pPvt = pShd;
+	pShd->dbNow = dbNow;
+	if(pShd->bStarted == 0)
+		forkShadow(pShd, pSrc, pLive, dbNow);
+	else if(pShd->sadi.nState != AD_STATE_RUN && dbNow > pShd->dbLastProcess)
+		pShd->dbHoldTime += dbNow - pShd->dbLastProcess;
+	pShd->dbLastProcess = dbNow;
+
+	// a hardware interlock of the modulator does not depend on the parameters
+	nLiveState = (int)pLive->dbStateRead;
+	if(nLiveState == MODE_FAULT && pShd->nLiveState != MODE_FAULT)
+	{
+		if(pShd->nMode == MODE_HV_ON)
+			++pShd->nTrips;
+		pShd->nMode = MODE_FAULT;
+	}
+	pShd->nLiveState = nLiveState;
+
+	refreshView(pShd, pSrc, pLive);
+	autoDriveTakeSample(&pShd->sadi, &pShd->view, dbNow, &smp);
+	autoDriveSample(&pShd->sadi, &smp);
+	nPrevState = pShd->sadi.nState;
+	autoDriveProcess(&pShd->sadi, &ops);
+	if(pShd->sadi.nState == AD_STATE_ALARM_DECREASE && nPrevState != AD_STATE_ALARM_DECREASE)
+		++pShd->nAlarms;
+
+	pShd->dbTimeToMax = timeToMax(pShd->dbHvSet, pShd->dbHvStart, dbNow - pShd->dbStart, pShd->sadi.dbHVMaxPoint);
+	pShd->dbLiveTimeToMax = timeToMax(pLive->dbHVPSVoltSet, pShd->dbLiveHvStart, dbNow - pShd->dbStart, pSrc->dbHVMaxPoint);
+}
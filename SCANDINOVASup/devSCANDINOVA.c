@@ -11,25 +11,84 @@
 #include <alarm.h>
 #include <epicsStdio.h>
 #include <devCommonGpib.h>
+#include <asynOctetSyncIO.h>
 #include <menuFtype.h>
 #include <errlog.h>
 #include <link.h>
 #include <dbCommon.h>
 #include <dbDefs.h>
 #include <aiRecord.h>
+#include <recGbl.h>
 #include <osiUnistd.h>
 #include <cantProceed.h>
 #include <iocsh.h>
 #include <epicsAssert.h>
 #include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
 #include <epicsTime.h>
 #include <epicsTimer.h>
+#include <drvSup.h>
 #include <epicsExport.h>
 
 #include "devSCANDINOVA.h"
+#include "scandinovaThread.h"
 
 SCANDINOVA_INFO SDN[MAX_SCANDINOVA_CNT];
 
+// record name prefix of the commands of each modulator (scandinovaDeviceConfigure)
+static char devPrefix[MAX_SCANDINOVA_CNT][64] = {"FEL:ATF03:"};
+static int bPrefixWarned[MAX_SCANDINOVA_CNT];
+
+// L of a record link is the SDN index
+static int badDevice(int nDevIdx)
+{
+	return nDevIdx < 0 || nDevIdx >= MAX_SCANDINOVA_CNT;
+}
+
+// wakes an auto drive thread before its 1 sec period (fast path crossing)
+#define AD_THREAD_PERIOD		1.0		// (unit: sec)
+static epicsEventId adWakeEvent[MAX_SCANDINOVA_CNT][MAX_SCANDINOVA_VACUUM_COUNT];
+static epicsThreadId adThread[MAX_SCANDINOVA_CNT][MAX_SCANDINOVA_VACUUM_COUNT];
+
+#define AD_SAMPLE_QUEUE			8		// ping samples between two auto drive loops
+
+// fast path crossings and ping samples, posted by the port thread to the auto drive thread owning SADI
+typedef struct
+{
+	SCANDINOVA_FAST_LATCH LAT;		// port thread only
+	int bTripPending;
+	double dbTripHv;				// hv read back at the trip crossing
+	double dbSignalTime;
+	SCANDINOVA_AD_SAMPLE SMP[AD_SAMPLE_QUEUE];
+	int nSmpHead;					// oldest
+	int nSmpCount;					// full: the oldest is overwritten
+	int bMaxPointPending;			// dbHVMaxPoint from the recipe thread
+	double dbMaxPoint;
+} AD_FAST_EVENT;
+static AD_FAST_EVENT adFast[MAX_SCANDINOVA_CNT][MAX_SCANDINOVA_VACUUM_COUNT];
+static epicsMutexId adFastLock;
+
+// auto drive thread load for scandinovaReport
+typedef struct
+{
+	double dbStart;
+	int nLoops;
+	double dbBusy;					// (unit: sec)
+	double dbBusyMax;
+	SCANDINOVA_JITTER_INFO JIT;		// wakeup vs period or fast path signal
+} AD_THREAD_STAT;
+static AD_THREAD_STAT adStat[MAX_SCANDINOVA_CNT][MAX_SCANDINOVA_VACUUM_COUNT];
+
+// shadow auto drives, run by the thread of their source channel
+static SCANDINOVA_SHADOW_INFO adShadow[MAX_SCANDINOVA_CNT][MAX_SCANDINOVA_SHADOW_COUNT];
+
+// ping 0 receive time vs the poll period of SCAN1FAN, port thread wakeup
+static SCANDINOVA_JITTER_INFO portJitter[MAX_SCANDINOVA_CNT];
+
+int scandinovaTraceMask = 0;
+epicsExportAddress(int, scandinovaTraceMask);
+
 /******************************************************************************
  *
  * The following define statements are used to declare the names to be used
@@ -59,9 +118,6 @@ SCANDINOVA_INFO SDN[MAX_SCANDINOVA_CNT];
 #define TIMEOUT     1.0    /* I/O must complete within this time */
 #define TIMEWINDOW  2.0    /* Wait this long after device timeout */
 
-#define MAX_TOKEN 20
-#define MAX_LEN 512
-
 /******************************************************************************
  * String arrays for EFAST operations. The last entry must be 0.
  *
@@ -87,11 +143,227 @@ static int procPing3Msg(struct gpibDpvt *pdpvt, int P1, int P2, char **P3);
 static int convertAiData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3);
 static int convertAoData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3);
 static int convertMbbiData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3);
+static int sendVerifiedWrite(struct gpibDpvt *pdpvt, int P1, int P2, char **P3);
 static void runAutoDriveThreadFunc(void *lParam);
 int changeMode(int nDevIdx, int nMode);
 int setHv(int nDevIdx, double dbSetpoint);
-int increaseHv(SCANDINOVA_AUTO_DRIVE_INFO *p);
-int hwControlset(int nDevIdx, int nMode);
+int hwControlSet(int nDevIdx, int nMode);
+
+/******************************************************************************
+ * Auto drive clock/actuator interface of the running IOC
+ *****************************************************************************/
+static double liveGetTime(void *pPvt)
+{
+	epicsTimeStamp tNow;
+	epicsTimeGetCurrent(&tNow);
+	return tNow.secPastEpoch + tNow.nsec * 1e-9;
+}
+static SCANDINOVA_INFO *liveGetInfo(void *pPvt, int nDevIdx)
+{
+	return &SDN[nDevIdx];
+}
+static int liveChangeMode(void *pPvt, int nDevIdx, int nMode)
+{
+	return changeMode(nDevIdx, nMode);
+}
+static int liveSetHv(void *pPvt, int nDevIdx, double dbSetpoint)
+{
+	return setHv(nDevIdx, dbSetpoint);
+}
+static int liveHwControlSet(void *pPvt, int nDevIdx, int nMode)
+{
+	return hwControlSet(nDevIdx, nMode);
+}
+
+static int liveGrantStep(void *pPvt, int nDevIdx, int nIdx, double dbFrom, double dbTo)
+{
+	return rampGroupGrant(nDevIdx, nIdx, dbFrom, dbTo);
+}
+
+static const SCANDINOVA_AUTO_DRIVE_OPS liveOps = {
+	liveGetTime, liveGetInfo, liveChangeMode, liveSetHv, liveHwControlSet, liveGrantStep, NULL
+};
+
+/*
+ * Soft interlock on the fresh vacuum value of ping 1, still in the port
+ * thread: a trip high crossing writes the standby command on this port
+ * right away, the auto drive threads are woken for trips and alarms and
+ * latch the trip themselves (SADI is only changed by its own thread).
+ */
+static void fastInterlock(struct gpibDpvt *pdpvt, int nDevIdx, const epicsTimeStamp *ptRecv)
+{
+	AD_FAST_EVENT *pFast;
+	int i;
+	int nRet;
+	int bTrip = 0;
+	char strCmd[32];
+	size_t nBytes;
+	epicsTimeStamp tNow;
+
+	for(i=0;i!=MAX_SCANDINOVA_VACUUM_COUNT;++i)
+	{
+		pFast = &adFast[nDevIdx][i];
+		nRet = autoDriveFastCheck(&SDN[nDevIdx].SADI[i],&pFast->LAT);
+		if(nRet == AD_FAST_NONE)
+			continue;
+
+		epicsMutexMustLock(adFastLock);
+		if(nRet == AD_FAST_TRIP)
+		{
+			bTrip = 1;
+			pFast->bTripPending = 1;
+			pFast->dbTripHv = SDN[nDevIdx].dbHVPSVoltRead;
+		}
+		pFast->dbSignalTime = liveGetTime(NULL);
+		epicsMutexUnlock(adFastLock);
+		epicsEventSignal(adWakeEvent[nDevIdx][i]);
+	}
+	if(bTrip == 0)
+		return;
+
+	sprintf(strCmd,"{W|001|%04X}",0x0A000);
+	if(pdpvt->pasynOctet->write(pdpvt->asynOctetPvt,pdpvt->pasynUser,strCmd,strlen(strCmd),&nBytes) != asynSuccess)
+	{
+		epicsPrintf("devSCANDINOVA[%d]: fast standby write failed: %s\n",nDevIdx,pdpvt->pasynUser->errorMessage);
+		return;
+	}
+	epicsTimeGetCurrent(&tNow);
+	SDN[nDevIdx].dbTripLatency = epicsTimeDiffInSeconds(&tNow,ptRecv);
+	++SDN[nDevIdx].nFastTrips;
+	scandinovaVerifyStart(&SDN[nDevIdx].VFY[SDN_VERIFY_STATE],0x0A000,liveGetTime(NULL));
+}
+
+/******************************************************************************
+ * Verified writes: state, hv and control word commands are matched against
+ * the following ping frames (writeVerify.c), retries go out in the port thread
+ *****************************************************************************/
+static const char *verifyFormat[SDN_VERIFY_COUNT] = {"{W|001|%04X}", "{W|3EB|%.4f}", "{W|003|%04X}"};
+static const char *verifyName[SDN_VERIFY_COUNT] = {"state", "hv", "control word"};
+static const char *verifyStatus[] = {"idle", "pending", "applied", "FAILED"};
+
+static int writeCommand(struct gpibDpvt *pdpvt, int nCmd, double dbValue)
+{
+	char strCmd[64];
+	size_t nBytes;
+
+	if(nCmd == SDN_VERIFY_HV)
+		sprintf(strCmd,verifyFormat[nCmd],dbValue);
+	else
+		sprintf(strCmd,verifyFormat[nCmd],(int)dbValue);
+	if(pdpvt->pasynOctet->write(pdpvt->asynOctetPvt,pdpvt->pasynUser,strCmd,strlen(strCmd),&nBytes) != asynSuccess)
+		return -1;
+	return 0;
+}
+
+// 3, 36, 39 (GPIBCVTIO, P1: SDN_VERIFY_xxx)
+static int sendVerifiedWrite(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
+{
+	struct aoRecord *pAo;
+	struct longoutRecord *pLo;
+	struct link *pLink;
+	double dbValue;
+	int nDevIdx;
+
+	if(P1 == SDN_VERIFY_HV)
+	{
+		pAo = (struct aoRecord *)pdpvt->precord;
+		pLink = &pAo->out;
+		dbValue = pAo->oval;
+	}
+	else
+	{
+		pLo = (struct longoutRecord *)pdpvt->precord;
+		pLink = &pLo->out;
+		dbValue = pLo->val;
+	}
+	nDevIdx = pLink->value.gpibio.link;
+	if(badDevice(nDevIdx))
+		return -1;
+
+	if(writeCommand(pdpvt,P1,dbValue) != 0)
+	{
+		epicsPrintf("devSCANDINOVA[%d]: %s write failed: %s\n",nDevIdx,verifyName[P1],pdpvt->pasynUser->errorMessage);
+		return -1;
+	}
+	scandinovaVerifyStart(&SDN[nDevIdx].VFY[P1],dbValue,liveGetTime(NULL));
+	return 0;
+}
+
+// a decoded ping 0 or 2: confirm, retry or fail the pending writes
+static void verifyWrites(struct gpibDpvt *pdpvt, int nDevIdx, int nPage)
+{
+	SCANDINOVA_VERIFY_INFO *pVfy;
+	int nFailed[SDN_VERIFY_COUNT];
+	int nResend;
+	int i;
+
+	for(i=0;i!=SDN_VERIFY_COUNT;++i)
+		nFailed[i] = SDN[nDevIdx].VFY[i].nFailed;
+	nResend = scandinovaVerifyFrame(&SDN[nDevIdx],nPage,SDN[nDevIdx].dbPageTime[nPage]);
+
+	for(i=0;i!=SDN_VERIFY_COUNT;++i)
+	{
+		pVfy = &SDN[nDevIdx].VFY[i];
+		if(pVfy->nFailed != nFailed[i])
+			epicsPrintf("devSCANDINOVA[%d]: %s %g not applied after %d retries\n",nDevIdx,verifyName[i],pVfy->dbValue,pVfy->nTries);
+		if((nResend & (1 << i)) == 0)
+			continue;
+		if(scandinovaTraceMask & SDN_TRACE_COMMAND)
+			epicsPrintf("devSCANDINOVA[%d]: %s %g not applied, retry %d\n",nDevIdx,verifyName[i],pVfy->dbValue,pVfy->nTries + 1);
+		writeCommand(pdpvt,i,pVfy->dbValue);
+		scandinovaVerifyRetry(pVfy,liveGetTime(NULL));
+	}
+}
+
+// ping page of a ping derived value, -1: none
+static int pageOfParam(int nNum)
+{
+	if(nNum == 2 || (nNum >= 4 && nNum <= 19))
+		return 0;
+	if(nNum >= 20 && nNum <= 28)
+		return 1;
+	if((nNum >= 31 && nNum <= 35) || nNum == 45 || nNum == 46)
+		return 2;
+	if(nNum >= 108 && nNum <= 111)
+		return nNum - 108;
+	return -1;
+}
+
+static double pageAge(int nDevIdx, int nPage)
+{
+	return liveGetTime(NULL) - SDN[nDevIdx].dbPageTime[nPage];
+}
+
+// no frame yet: the record processing time
+static void frameTimeStamp(int nDevIdx, int nPage, epicsTimeStamp *pTime)
+{
+	if(SDN[nDevIdx].dbPageTime[nPage] > 0)
+		*pTime = SDN[nDevIdx].tPageRecv[nPage];
+	else
+		epicsTimeGetCurrent(pTime);
+}
+
+// hand a decoded ping to the auto drive threads (settle detection, adaptive ramp)
+static void sampleAutoDrive(int nDevIdx)
+{
+	AD_FAST_EVENT *pFast;
+	SCANDINOVA_AD_SAMPLE smp;
+	int i;
+	double dbNow = liveGetTime(NULL);
+
+	for(i=0;i!=MAX_SCANDINOVA_VACUUM_COUNT;++i)
+	{
+		pFast = &adFast[nDevIdx][i];
+		autoDriveTakeSample(&SDN[nDevIdx].SADI[i],&SDN[nDevIdx],dbNow,&smp);
+		epicsMutexMustLock(adFastLock);
+		pFast->SMP[(pFast->nSmpHead + pFast->nSmpCount) % AD_SAMPLE_QUEUE] = smp;
+		if(pFast->nSmpCount == AD_SAMPLE_QUEUE)
+			pFast->nSmpHead = (pFast->nSmpHead + 1) % AD_SAMPLE_QUEUE;
+		else
+			++pFast->nSmpCount;
+		epicsMutexUnlock(adFastLock);
+	}
+}
 
 static struct gpibCmd gpibCmds[] = {
 	// 0: ping 0
@@ -108,8 +380,8 @@ static struct gpibCmd gpibCmds[] = {
 	// 3: AO state set
 	//{&DSET_AO, GPIBCVTIO, IB_Q_HIGH, NULL, NULL, 0, 32, 
 	//	sendAoCommand, 'W', 0x001, NULL, NULL, NULL},
-	{&DSET_LO, GPIBWRITE, IB_Q_HIGH, NULL, "{W|001|%04X}", 0, 32,
-		NULL, 0, 0, NULL, NULL, NULL},
+	{&DSET_LO, GPIBCVTIO, IB_Q_HIGH, NULL, "{W|001|%04X}", 0, 32,
+		sendVerifiedWrite, SDN_VERIFY_STATE, 0, NULL, NULL, NULL},
 	// 4 ~ 19
 	// 4: AI state read 
 	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
@@ -183,8 +455,8 @@ static struct gpibCmd gpibCmds[] = {
 		convertAiData, 0, 0, NULL, NULL, NULL},	// 31~35 END
 	
 	// 36 control word set
-	{&DSET_LO, GPIBWRITE, IB_Q_HIGH, NULL, "{W|003|%04X}", 0, 32,
-		NULL, 0, 0, NULL, NULL, NULL},
+	{&DSET_LO, GPIBCVTIO, IB_Q_HIGH, NULL, "{W|003|%04X}", 0, 32,
+		sendVerifiedWrite, SDN_VERIFY_CONTROL, 0, NULL, NULL, NULL},
 	// 37 PrfSet
 	{&DSET_LO, GPIBWRITE, IB_Q_HIGH, NULL, "{W|12C|%ld}", 0, 32,
 		NULL, 0, 0, NULL, NULL, NULL},
@@ -192,8 +464,8 @@ static struct gpibCmd gpibCmds[] = {
 	{&DSET_AO, GPIBWRITE, IB_Q_HIGH, NULL, "{W|2BE|%.4f}", 0, 32,
 		NULL, 0, 0, NULL, NULL, NULL},
 	// 39 hvps voltage set
-	{&DSET_AO, GPIBWRITE, IB_Q_HIGH, NULL, "{W|3EB|%.4f}", 0, 32,
-		NULL, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBCVTIO, IB_Q_HIGH, NULL, "{W|3EB|%.4f}", 0, 32,
+		sendVerifiedWrite, SDN_VERIFY_HV, 0, NULL, NULL, NULL},
 	// 40 Plswth set
 	{&DSET_AO, GPIBWRITE, IB_Q_HIGH, NULL, "{W|4B3|%.4f}", 0, 32,
 		NULL, 0, 0, NULL, NULL, NULL},
@@ -271,19 +543,415 @@ static struct gpibCmd gpibCmds[] = {
 		convertAoData, 0, 0, NULL, NULL, NULL},
 	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
 		convertAoData, 0, 0, NULL, NULL, NULL},
-	
+
+	// 73 ~ 77 auto drive settle detection get
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+
+	// 78 ~ 81 auto drive settle detection set
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+
+	// 82 ~ 85 hv slew generator set (target, slew rate, update rate, use)
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+
+	// 86 ~ 91 hv slew generator get
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+
+	// 92 ~ 99 auto drive adaptive ramp get
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+
+	// 100 ~ 105 auto drive adaptive ramp set
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+
+	// 106, 107 fast path trip latency, fast trip count
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+
+	// 108 ~ 111 ping 0 ~ 3 data age, 112 stale limit get
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	// 113 stale limit set
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	// 114 ~ 116 auto drive stale limit, stale standby, stale get
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	// 117, 118 auto drive stale limit, stale standby set
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+
+	// 119, 120 startup time, data ready
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+
+	// 121 recipe command, 122 ~ 128 recipe state, step, step count, progress, eta, dwell, back offs
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+
+	// 129 ~ 136 ramp scheduler group, rank, grants, defers, group power, power budget, dv left, dv budget
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	// 137, 138 ramp scheduler power budget, dv budget set
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	// 139 first fault reset, 140 first fault mask set, 141 first fault mask
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	// 142, 143 auto drive wakeup jitter, max, 144, 145 port (ping 0) jitter, max, 146 jitter reset
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	// 147 ~ 152 write verification (A: SDN_VERIFY_xxx) status, latency, max latency, applied, retries, failed
+	{&DSET_MBBI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertMbbiData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	// 153 verify timeout set, 154 verify timeout, 155 verify retries set, 156 verify retries, 157 verify counters reset
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	// 158 shadow (A: shadow) start/stop, 159 in use, 160 hv, 161 hv - live hv, 162 auto drive state,
+	// 163 state word, 164 trips, 165 alarms, 166 hv steps, 167 hold time, 168 time to max, 169 source time to max
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	// 170 poll period, 171 poll phase, 172 polls, 173 overruns, 174 missed slots, 175 poll latency, 176 max latency,
+	// 177 poll period set, 178 poll phase set (< 0: even spread), 179 polls without an answer
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AO, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32,
+		convertAoData, 0, 0, NULL, NULL, NULL},
+	{&DSET_AI, GPIBSOFT, IB_Q_HIGH, NULL, NULL, 0, 32, 
+		convertAiData, 0, 0, NULL, NULL, NULL},	
+
 };
 
 /* The following is the number of elements in the command array above.  */
 #define NUMPARAMS sizeof(gpibCmds)/sizeof(struct gpibCmd)
 
+static void tracePing(int nDevIdx, int nPage, const char *recvBuf, char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN], int nCnt)
+{
+	int nIdx;
+
+	if((scandinovaTraceMask & (SDN_TRACE_PING0 << nPage)) == 0)
+		return;
+	epicsPrintf("devSCANDINOVA[%d]: ping %d source: %s\n",nDevIdx,nPage,recvBuf);
+	epicsPrintf("mySplit count = %d\n",nCnt);
+	for(nIdx=0;nIdx<nCnt;++nIdx)
+		epicsPrintf("[%d]: %s\n",nIdx,result[nIdx]);
+}
+
+// frame without the expected "{p|00n" prefix
+static void pingRejected(int nDevIdx, int nPage, const char *recvBuf)
+{
+	++SDN[nDevIdx].PGD[nPage].nParseErrors;
+	if(scandinovaTraceMask & SDN_TRACE_ERROR)
+		epicsPrintf("devSCANDINOVA[%d]: ping %d rejected: %s\n",nDevIdx,nPage,recvBuf);
+}
+
+// a page was stored (ping record or startup ping)
+static void pageDecoded(int nDevIdx, int nPage, const epicsTimeStamp *ptRecv)
+{
+	SCANDINOVA_PAGE_DIAG *pDiag = &SDN[nDevIdx].PGD[nPage];
+	double dbNow = ptRecv->secPastEpoch + ptRecv->nsec * 1e-9;
+	double dbLast = SDN[nDevIdx].dbPageTime[nPage];
+	double dbPrev;
+	double dbPeriod;
+
+	if(dbLast > 0)
+	{
+		pDiag->dbInterval = dbNow - dbLast;
+		if(pDiag->nFrames == 1 || pDiag->dbInterval < pDiag->dbIntervalMin)
+			pDiag->dbIntervalMin = pDiag->dbInterval;
+		pDiag->dbIntervalMax = fmax(pDiag->dbIntervalMax, pDiag->dbInterval);
+		pDiag->dbIntervalSum += pDiag->dbInterval;
+		if((scandinovaTraceMask & SDN_TRACE_SLOW) && pDiag->dbInterval > SDN_SLOW_PING_INTERVAL)
+			epicsPrintf("devSCANDINOVA[%d]: slow ping %d, %.3f sec since the last frame\n",nDevIdx,nPage,pDiag->dbInterval);
+		// a missed poll is no jitter
+		dbPeriod = scandinovaPollPeriod(nDevIdx);
+		if(nPage == 0 && pDiag->dbInterval < 2 * dbPeriod)
+			scandinovaJitterSample(&portJitter[nDevIdx],dbLast + dbPeriod,dbNow);
+	}
+	// the pages of a poll are queued together, so this is the round trip of this ping
+	dbPrev = nPage > 0 ? SDN[nDevIdx].dbPageTime[nPage-1] : 0;
+	if(dbPrev > 0 && dbNow - dbPrev < TIMEOUT)
+	{
+		pDiag->dbLatency = dbNow - dbPrev;
+		pDiag->dbLatencyMax = fmax(pDiag->dbLatencyMax, pDiag->dbLatency);
+	}
+	++pDiag->nFrames;
+
+	SDN[nDevIdx].dbPageTime[nPage] = dbNow;
+	SDN[nDevIdx].tPageRecv[nPage] = *ptRecv;
+	if(SDN[nDevIdx].dbPageTime[0] > 0 && SDN[nDevIdx].dbPageTime[1] > 0)
+		SDN[nDevIdx].bReady = 1;
+	if(nPage == 0)
+		scandinovaFaultSample(&SDN[nDevIdx].FFL,(int)SDN[nDevIdx].dbStateRead,dbNow);
+	if(nPage == 0 || nPage == 2)
+		scandinovaWordUpdate(nDevIdx);
+	scandinovaPollDecoded(nDevIdx, nPage, dbNow);
+	scandinovaShmPublish(nDevIdx, nPage, ptRecv);
+}
+
+/*
+ * Synchronous ping of all pages from init_ai pass 1 (before the scan tasks
+ * start), so records and the auto drive begin with real data.
+ */
+static void startupPing(int nDevIdx)
+{
+	asynUser *pasynUser;
+	char portName[32];
+	char strCmd[16];
+	char recvBuf[300];
+	char eosBuf[8];
+	int nEosLen = 0;
+	size_t nOut,nIn;
+	int nEom;
+	int nPage;
+	epicsTimeStamp tRecv;
+
+	// asyn port of the "#L<link> A<addr>" links
+	sprintf(portName,"L%d",nDevIdx);
+	if(pasynOctetSyncIO->connect(portName,0,&pasynUser,NULL) != asynSuccess)
+	{
+		epicsPrintf("devSCANDINOVA[%d]: startup ping: cannot connect to port %s\n",nDevIdx,portName);
+		return;
+	}
+	if(pasynOctetSyncIO->getInputEos(pasynUser,eosBuf,sizeof(eosBuf),&nEosLen) != asynSuccess)
+		nEosLen = 0;
+	pasynOctetSyncIO->setInputEos(pasynUser,"}",1);
+
+	for(nPage=0;nPage!=MAX_SCANDINOVA_PAGE_COUNT;++nPage)
+	{
+		sprintf(strCmd,"{P|%03d}",nPage);
+		if(pasynOctetSyncIO->writeRead(pasynUser,strCmd,strlen(strCmd),recvBuf,sizeof(recvBuf)-1,
+					TIMEOUT,&nOut,&nIn,&nEom) != asynSuccess)
+		{
+			epicsPrintf("devSCANDINOVA[%d]: startup ping %d failed: %s\n",nDevIdx,nPage,pasynUser->errorMessage);
+			continue;
+		}
+		epicsTimeGetCurrent(&tRecv);
+		recvBuf[nIn] = '\0';
+		if(scandinovaParsePing(&SDN[nDevIdx],nPage,recvBuf,nIn) != 0)
+		{
+			pingRejected(nDevIdx,nPage,recvBuf);
+			continue;
+		}
+		pageDecoded(nDevIdx,nPage,&tRecv);
+	}
+
+	pasynOctetSyncIO->setInputEos(pasynUser,eosBuf,nEosLen);
+	pasynOctetSyncIO->disconnect(pasynUser);
+}
+
+// worker of an enabled auto drive channel, created on first use
+// a modulator is present when the asyn port of its "#L<link>" links exists
+static int devicePresent(int nDevIdx)
+{
+	asynUser *pasynUser;
+	char portName[32];
+	int bPresent;
+
+	sprintf(portName,"L%d",nDevIdx);
+	pasynUser = pasynManager->createAsynUser(NULL,NULL);
+	bPresent = pasynManager->connectDevice(pasynUser,portName,0) == asynSuccess;
+	if(bPresent)
+		pasynManager->disconnect(pasynUser);
+	pasynManager->freeAsynUser(pasynUser);
+	return bPresent;
+}
+
+static void startAutoDrive(int nDevIdx, int nIdx)
+{
+	SCANDINOVA_AUTO_DRIVE_INFO *p = &SDN[nDevIdx].SADI[nIdx];
+	char thName[64];
+
+	if(adThread[nDevIdx][nIdx] != NULL || p->bUse == 0)
+		return;
+
+	autoDriveStart(p,&liveOps);
+	sprintf(thName,"AUTODRIVE#%d_%d",nDevIdx,nIdx);
+	adThread[nDevIdx][nIdx] = scandinovaThreadCreate(SDN_THREAD_AUTODRIVE,thName,epicsThreadPriorityHigh,epicsThreadStackSmall,
+			(EPICSTHREADFUNC)runAutoDriveThreadFunc,p);
+	epicsPrintf("creat the scandinova auto drive func... [%d][%d] - %d,%d\n",nDevIdx,nIdx,p->nIdx,p->bUse);
+}
+
 /******************************************************************************
  * Initialize device support parameters
  *
  *****************************************************************************/
 static long init_ai(int parm)
 {
-	char thName[256];
+	static double dbInitStart;
+	static int bStarted = 0;
 	int i,nDevIdx;
     if(parm==0) {
         devSupParms.name = "devSCANDINOVA";
@@ -293,53 +961,48 @@ static long init_ai(int parm)
         devSupParms.timeWindow = TIMEWINDOW;
         devSupParms.respond2Writes = -1;
 	
+		dbInitStart = liveGetTime(NULL);
 		memset(&SDN,0x00,sizeof(SCANDINOVA_INFO)*MAX_SCANDINOVA_CNT);
 		
 		// auto drive
+		adFastLock = epicsMutexMustCreate();
 
 		for(nDevIdx=0;nDevIdx!=MAX_SCANDINOVA_CNT;++nDevIdx)
 		{
 			SDN[nDevIdx].nDevIdx = nDevIdx;
+			SDN[nDevIdx].dbStaleLimit = 5;		// (unit: sec)
+			SDN[nDevIdx].FFL.nMask = SDN_FAULT_MASK_DEFAULT;
+			SDN[nDevIdx].dbVerifyTimeout = 3;	// (unit: sec)
+			SDN[nDevIdx].nVerifyRetries = 2;
+			scandinovaFaultReset(&SDN[nDevIdx].FFL);
 			for(i=0;i!=MAX_SCANDINOVA_VACUUM_COUNT;++i)
 			{
-				if(i==0)
-				{
-					SDN[nDevIdx].SADI[i].bUse = 1;
-					SDN[nDevIdx].SADI[i].dbVacuum = &SDN[i].dbSolonoidPs2CurrRead;
-					SDN[nDevIdx].SADI[i].dbTripHighLimit = 5.2;
-					SDN[nDevIdx].SADI[i].dbAlarmHighLimit = 4.8;
-					SDN[nDevIdx].SADI[i].dbAlarmLowLimit = 3.6;
-					SDN[nDevIdx].SADI[i].dbTripLowLimit = 3.5;
-					SDN[nDevIdx].SADI[i].dbHVRampSpeed = 1; // voltage
-					SDN[nDevIdx].SADI[i].dbHVRampCheckTime = 60; // second 		
-					SDN[nDevIdx].SADI[i].dbHVMaxPoint = 1290.0;
-
-					SDN[nDevIdx].SADI[i].dbTripBlockingTime = 300;
-					SDN[nDevIdx].SADI[i].dbAlarmBlockingTime = 30;
-					SDN[nDevIdx].SADI[i].dbAlarmDecreaseTime = 300;		// (unit: sec)
-
-					SDN[nDevIdx].SADI[i].dbHVTripGain = 90;		// percent
-					SDN[nDevIdx].SADI[i].dbHVAlarmGain = 100;	// percent
-					
-					SDN[nDevIdx].SADI[i].nPriority = MASTER;
-				}
-				else
-				{
-					SDN[nDevIdx].SADI[i].dbVacuum = &SDN[i].dbSolonoidPs2CurrRead;
-					SDN[nDevIdx].SADI[i].nPriority = SLAVE;
-					SDN[nDevIdx].SADI[i].bUse = 0;
-				}
-    
-				SDN[nDevIdx].SADI[i].nIdx = i;
-				SDN[nDevIdx].SADI[i].nParentId = nDevIdx;
-				epicsTimeGetCurrent(&SDN[nDevIdx].SADI[i].tLastIncrease);
-
-				sprintf(thName,"AUTODRIVE#%d_%d",nDevIdx,i);
-				epicsThreadCreate(thName,epicsThreadPriorityHigh,epicsThreadGetStackSize(epicsThreadStackSmall),
-						(EPICSTHREADFUNC)runAutoDriveThreadFunc,&SDN[nDevIdx].SADI[i]);
-				epicsPrintf("creat the scandinova auto drive func... [%d][%d] - %d,%d\n",nDevIdx,i
-						,SDN[nDevIdx].SADI[i].nIdx,SDN[nDevIdx].SADI[i].bUse);
+				autoDriveSetDefaults(&SDN[nDevIdx].SADI[i],nDevIdx,i);
+				SDN[nDevIdx].SADI[i].dbVacuum = &SDN[nDevIdx].dbSolonoidPs2CurrRead;
+				adWakeEvent[nDevIdx][i] = epicsEventMustCreate(epicsEventEmpty);
 			}
+
+			// no threads for modulators without a port
+			SDN[nDevIdx].bPresent = devicePresent(nDevIdx);
+			if(SDN[nDevIdx].bPresent == 0)
+				continue;
+			hvSlewInit(nDevIdx);
+			for(i=0;i!=MAX_SCANDINOVA_VACUUM_COUNT;++i)
+				startAutoDrive(nDevIdx,i);
+			recipeInit(nDevIdx);
+		}
+		rampGroupInit();
+    }
+    else if(bStarted == 0) {
+		bStarted = 1;
+		for(nDevIdx=0;nDevIdx!=MAX_SCANDINOVA_CNT;++nDevIdx)
+		{
+			if(SDN[nDevIdx].bPresent == 0)
+				continue;
+			startupPing(nDevIdx);
+			SDN[nDevIdx].dbStartupTime = liveGetTime(NULL) - dbInitStart;
+			epicsPrintf("devSCANDINOVA[%d]: startup %.3f sec, %s\n",nDevIdx,SDN[nDevIdx].dbStartupTime,
+					SDN[nDevIdx].bReady ? "ready" : "no data, auto drive waits for the first pings");
 		}
     }
     return(0);
@@ -347,155 +1010,77 @@ static long init_ai(int parm)
 
 static int procPing0Msg(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 {
-
-	  asynUser *pasynUser = pdpvt->pasynUser;
 	  struct biRecord *pBi= (struct biRecord *)pdpvt->precord;
 	  struct link *pLink = (struct link *)&pBi->inp;
-	  asynOctet *pasynOctet = pdpvt->pasynOctet;
-	  void *asynOctetPvt = pdpvt->asynOctetPvt;
 
-	  int j;
 	  size_t nRet;
 	  char recvBuf[300];
-	  char result[MAX_TOKEN][MAX_LEN];
+	  char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN];
 	  int nCnt;
-	  int nIdx = 0;
-	  char *beg,*end;
-	  int nAddr;
 	  int nDevIdx;
+	  epicsTimeStamp tRecv;
 
+	  epicsTimeGetCurrent(&tRecv);
 	  nDevIdx = pLink->value.gpibio.link;
-	  nAddr = pLink->value.gpibio.addr;
-	  strncpy(recvBuf,&pdpvt->msg[0],pdpvt->msgInputLen);
-	  nRet = pdpvt->msgInputLen;
-	  
-	  
-//	  if ((pasynOctet->write(asynOctetPvt,pasynUser,"{P|000}",sizeof"{P|000}" - 1,&nRet) != asynSuccess)
-//		|| (pasynOctet->read(asynOctetPvt,pasynUser,recvBuf,sizeof recvBuf - 1,&nRet,NULL) != asynSuccess)) 
-//	  {
-//		  epicsSnprintf(pasynUser->errorMessage,pasynUser->errorMessageSize,"PING I/O failed[%d]\n",nRet);
-//		  pBi->val = 0;
-//		  return -1;
-//	  }
-	  
-	  
-	  recvBuf[nRet] = '\0';
-	  
-	  if(strncmp(recvBuf,"{p|000",6) != 0)
+	  if(badDevice(nDevIdx))
+	  {
+		  recGblSetSevr(pBi, READ_ALARM, INVALID_ALARM);
 		  return 0;
+	  }
+	  nRet = pdpvt->msgInputLen < sizeof(recvBuf) ? pdpvt->msgInputLen : sizeof(recvBuf) - 1;
+	  memcpy(recvBuf,&pdpvt->msg[0],nRet);
+	  recvBuf[nRet] = '\0';
 
-	  nCnt = 0;
-	  beg = &recvBuf[1];
-	  end = &recvBuf[nRet];
-	  while(beg<end)
+	  nCnt = scandinovaSplitPing(recvBuf,nRet,"{p|000",result);
+	  if(nCnt == 0 || scandinovaStorePing(&SDN[nDevIdx],0,result,nCnt) != 0)
 	  {
-		  if(*beg != '|')
-		  {
-			  result[nCnt][nIdx++] = *beg;
-		  }
-		  else
-		  {
-			  result[nCnt][nIdx] = '\0';
-			  nIdx = 0;
-			  ++nCnt;
-		  }
-		  ++beg;
+		  pingRejected(nDevIdx,0,recvBuf);
+		  return 0;
 	  }
-	  ++nCnt;
-
-//#define DEBUG_PING0
-#ifdef DEBUG_PING0
-	  epicsPrintf("source: %s\n",recvBuf);
-	  epicsPrintf("mySplit count = %d\n",nCnt);
-	  for(nIdx=0;nIdx<nCnt;++nIdx)
-		  epicsPrintf("[%d]: %s\n",nIdx,result[nIdx]);
-#endif
-
-	SDN[nDevIdx].dbStateSet = strtoul(result[3],NULL,16);
-	SDN[nDevIdx].dbStateRead = strtoul(result[2],NULL,16);
-	SDN[nDevIdx].dbFilamentVoltRead = atof(result[4]);
-	SDN[nDevIdx].dbFilamentCurrRead = atof(result[5]);
-	SDN[nDevIdx].dbCtRead = atof(result[6]);
-	SDN[nDevIdx].dbCvdRead = atof(result[7]);
-	SDN[nDevIdx].dbCtArcPerSecondRead = strtoul(result[8],NULL,16);
-	SDN[nDevIdx].dbCvdArcPerSecondRead = strtoul(result[9],NULL,16);
-	SDN[nDevIdx].dbPrfRead = atof(result[10]);
-	SDN[nDevIdx].dbPlswthRead = atof(result[11]);
-	SDN[nDevIdx].dbPowRead = atof(result[12]);
-	SDN[nDevIdx].dbHVPSVoltRead = atof(result[13]);
-	SDN[nDevIdx].dbHVPSVoltSet = atof(result[14]);
-	SDN[nDevIdx].dbPlswthSet = atof(result[15]);
-	SDN[nDevIdx].dbPrfSet = atof(result[16]);
-	SDN[nDevIdx].dbRemainingTime = strtoul(result[17],NULL,16);
-	SDN[nDevIdx].dbAccessLevel = strtoul(result[18],NULL,16);
-	pBi->val = 1;
+	  tracePing(nDevIdx,0,recvBuf,result,nCnt);
+
+	pageDecoded(nDevIdx,0,&tRecv);
+	verifyWrites(pdpvt,nDevIdx,0);
+	sampleAutoDrive(nDevIdx);
+
+	  pBi->val = 1;
 	  return 0;
 }
 
 static int procPing1Msg(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 {
-	  asynUser *pasynUser = pdpvt->pasynUser;
 	  struct biRecord *pBi= (struct biRecord *)pdpvt->precord;
 	  struct link *pLink = (struct link *)&pBi->inp;
-	  asynOctet *pasynOctet = pdpvt->pasynOctet;
-	  void *asynOctetPvt = pdpvt->asynOctetPvt;
 
-	  int j;
 	  size_t nRet;
 	  char recvBuf[300];
-	  char result[MAX_TOKEN][MAX_LEN];
+	  char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN];
 	  int nCnt;
-	  int nIdx = 0;
-	  char *beg,*end;
-	  int nAddr,nDevIdx;
-	  
+	  int nDevIdx;
+	  epicsTimeStamp tRecv;
+
+	  epicsTimeGetCurrent(&tRecv);
 	  nDevIdx = pLink->value.gpibio.link;
-	  nAddr = pLink->value.gpibio.addr;
-	  strncpy(recvBuf,&pdpvt->msg[0],pdpvt->msgInputLen);
-	  nRet = pdpvt->msgInputLen;
-	  
-	  recvBuf[nRet] = '\0';
-	  
-	  if(strncmp(recvBuf,"{p|001",6) != 0)
+	  if(badDevice(nDevIdx))
+	  {
+		  recGblSetSevr(pBi, READ_ALARM, INVALID_ALARM);
 		  return 0;
+	  }
+	  nRet = pdpvt->msgInputLen < sizeof(recvBuf) ? pdpvt->msgInputLen : sizeof(recvBuf) - 1;
+	  memcpy(recvBuf,&pdpvt->msg[0],nRet);
+	  recvBuf[nRet] = '\0';
 
-
-	  nCnt = 0;
-	  beg = &recvBuf[1];
-	  end = &recvBuf[nRet];
-	  while(beg<end)
+	  nCnt = scandinovaSplitPing(recvBuf,nRet,"{p|001",result);
+	  if(nCnt == 0 || scandinovaStorePing(&SDN[nDevIdx],1,result,nCnt) != 0)
 	  {
-		  if(*beg != '|')
-		  {
-			  result[nCnt][nIdx++] = *beg;
-		  }
-		  else
-		  {
-			  result[nCnt][nIdx] = '\0';
-			  nIdx = 0;
-			  ++nCnt;
-		  }
-		  ++beg;
+		  pingRejected(nDevIdx,1,recvBuf);
+		  return 0;
 	  }
-	  ++nCnt;
-
-//#define DEBUG_PING1
-#ifdef DEBUG_PING1
-	  epicsPrintf("source: %s\n",recvBuf);
-	  epicsPrintf("mySplit count = %d\n",nCnt);
-	  for(nIdx=0;nIdx<nCnt;++nIdx)
-		  epicsPrintf("[%d]: %s\n",nIdx,result[nIdx]);
-#endif
-
-	SDN[nDevIdx].dbSolonoidPs1VoltRead = atof(result[2]);
-	SDN[nDevIdx].dbSolonoidPs1CurrRead = atof(result[3]);
-	SDN[nDevIdx].dbSolonoidPs1CurrSet = atof(result[4]);
-	SDN[nDevIdx].dbSolonoidPs2VoltRead = atof(result[5]);
-	SDN[nDevIdx].dbSolonoidPs2CurrRead = atof(result[6]);
-	SDN[nDevIdx].dbSolonoidPs3VoltRead = atof(result[7]);
-	SDN[nDevIdx].dbSolonoidPs3CurrRead = atof(result[8]);
-	SDN[nDevIdx].dbSolonoidPs4VoltRead = atof(result[9]);
-	SDN[nDevIdx].dbPresRead1 = atof(result[10]);
+	  tracePing(nDevIdx,1,recvBuf,result,nCnt);
+
+	pageDecoded(nDevIdx,1,&tRecv);
+	fastInterlock(pdpvt, nDevIdx, &tRecv);
+	sampleAutoDrive(nDevIdx);
 
 	  pBi->val = 1;
 	  return 0;
@@ -503,65 +1088,37 @@ static int procPing1Msg(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 
 static int procPing2Msg(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 {
-	  asynUser *pasynUser = pdpvt->pasynUser;
 	  struct biRecord *pBi= (struct biRecord *)pdpvt->precord;
 	  struct link *pLink = (struct link *)&pBi->inp;
-	  asynOctet *pasynOctet = pdpvt->pasynOctet;
-	  void *asynOctetPvt = pdpvt->asynOctetPvt;
 
-	  int j;
 	  size_t nRet;
 	  char recvBuf[300];
-	  char result[MAX_TOKEN][MAX_LEN];
+	  char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN];
 	  int nCnt;
-	  int nIdx = 0;
-	  char *beg,*end;
-	  int nAddr,nDevIdx;
-	  
+	  int nDevIdx;
+	  epicsTimeStamp tRecv;
+
+	  epicsTimeGetCurrent(&tRecv);
 	  nDevIdx = pLink->value.gpibio.link;
-	  nAddr = pLink->value.gpibio.addr;
-	  strncpy(recvBuf,&pdpvt->msg[0],pdpvt->msgInputLen);
-	  nRet = pdpvt->msgInputLen;
-	  
-	  recvBuf[nRet] = '\0';
-	  
-	  if(strncmp(recvBuf,"{p|002",6) != 0)
+	  if(badDevice(nDevIdx))
+	  {
+		  recGblSetSevr(pBi, READ_ALARM, INVALID_ALARM);
 		  return 0;
-	  
-	  nCnt = 0;
-	  beg = &recvBuf[1];
-	  end = &recvBuf[nRet];
-	  while(beg<end)
+	  }
+	  nRet = pdpvt->msgInputLen < sizeof(recvBuf) ? pdpvt->msgInputLen : sizeof(recvBuf) - 1;
+	  memcpy(recvBuf,&pdpvt->msg[0],nRet);
+	  recvBuf[nRet] = '\0';
+
+	  nCnt = scandinovaSplitPing(recvBuf,nRet,"{p|002",result);
+	  if(nCnt == 0 || scandinovaStorePing(&SDN[nDevIdx],2,result,nCnt) != 0)
 	  {
-		  if(*beg != '|')
-		  {
-			  result[nCnt][nIdx++] = *beg;
-		  }
-		  else
-		  {
-			  result[nCnt][nIdx] = '\0';
-			  nIdx = 0;
-			  ++nCnt;
-		  }
-		  ++beg;
+		  pingRejected(nDevIdx,2,recvBuf);
+		  return 0;
 	  }
-	  ++nCnt;
-
-//#define DEBUG_PING2
-#ifdef DEBUG_PING2
-	  epicsPrintf("source: %s\n",recvBuf);
-	  epicsPrintf("mySplit count = %d\n",nCnt);
-	  for(nIdx=0;nIdx<nCnt;++nIdx)
-		  epicsPrintf("[%d]: %s\n",nIdx,result[nIdx]);
-#endif
-
-	SDN[nDevIdx].dbStandByCurrSet = atof(result[2]);
-	SDN[nDevIdx].dbSolonoidPs2CurrSet = atof(result[6]);
-	SDN[nDevIdx].dbControlWordSet = strtoul(result[3],NULL,16);
-	SDN[nDevIdx].dbSolonoidPs3CurrSet = atof(result[7]);
-	SDN[nDevIdx].dbSolonoidPs4CurrSet = atof(result[8]);
-	SDN[nDevIdx].dbSolonoidPs2CurrHighLimit = atof(result[4]);			// tunnel vacuum1 high limit
-	SDN[nDevIdx].dbSolonoidPs2CurrLowLimit = atof(result[5]);			// tunnel vacuum1 low limit
+	  tracePing(nDevIdx,2,recvBuf,result,nCnt);
+
+	pageDecoded(nDevIdx,2,&tRecv);
+	verifyWrites(pdpvt,nDevIdx,2);
 
 	  pBi->val = 1;
 	  return 0;
@@ -569,61 +1126,62 @@ static int procPing2Msg(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 
 static int procPing3Msg(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 {
-	  asynUser *pasynUser = pdpvt->pasynUser;
 	  struct biRecord *pBi= (struct biRecord *)pdpvt->precord;
 	  struct link *pLink = (struct link *)&pBi->inp;
-	  asynOctet *pasynOctet = pdpvt->pasynOctet;
-	  void *asynOctetPvt = pdpvt->asynOctetPvt;
 
-	  int j;
 	  size_t nRet;
 	  char recvBuf[300];
-	  char result[MAX_TOKEN][MAX_LEN];
+	  char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN];
 	  int nCnt;
-	  int nIdx = 0;
-	  char *beg,*end;
-	  int nAddr,nDevIdx;
-	  
+	  int nDevIdx;
+	  epicsTimeStamp tRecv;
+
+	  epicsTimeGetCurrent(&tRecv);
 	  nDevIdx = pLink->value.gpibio.link;
-	  nAddr = pLink->value.gpibio.addr;
-	  strncpy(recvBuf,&pdpvt->msg[0],pdpvt->msgInputLen);
-	  nRet = pdpvt->msgInputLen;
-	  
-	  recvBuf[nRet] = '\0';
-	  
-	  if(strncmp(recvBuf,"{p|003",6) != 0)
+	  if(badDevice(nDevIdx))
+	  {
+		  recGblSetSevr(pBi, READ_ALARM, INVALID_ALARM);
 		  return 0;
-	  
-	  nCnt = 0;
-	  beg = &recvBuf[1];
-	  end = &recvBuf[nRet];
-	  while(beg<end)
+	  }
+	  nRet = pdpvt->msgInputLen < sizeof(recvBuf) ? pdpvt->msgInputLen : sizeof(recvBuf) - 1;
+	  memcpy(recvBuf,&pdpvt->msg[0],nRet);
+	  recvBuf[nRet] = '\0';
+
+	  nCnt = scandinovaSplitPing(recvBuf,nRet,"{p|003",result);
+	  if(nCnt == 0 || scandinovaStorePing(&SDN[nDevIdx],3,result,nCnt) != 0)
 	  {
-		  if(*beg != '|')
-		  {
-			  result[nCnt][nIdx++] = *beg;
-		  }
-		  else
-		  {
-			  result[nCnt][nIdx] = '\0';
-			  nIdx = 0;
-			  ++nCnt;
-		  }
-		  ++beg;
+		  pingRejected(nDevIdx,3,recvBuf);
+		  return 0;
 	  }
-	  ++nCnt;
+	  tracePing(nDevIdx,3,recvBuf,result,nCnt);
 
-//#define DEBUG_PING3
-#ifdef DEBUG_PING3
-	  epicsPrintf("source: %s\n",recvBuf);
-	  epicsPrintf("mySplit count = %d\n",nCnt);
-	  for(nIdx=0;nIdx<nCnt;++nIdx)
-		  epicsPrintf("[%d]: %s\n",nIdx,result[nIdx]);
-#endif
+	pageDecoded(nDevIdx,3,&tRecv);
 
 	  pBi->val = 1;
 	  return 0;
 }
+// A of the shadow records (158 ~ 169) is the shadow index
+// number of A addresses of an indexed @N, 0: A is not used
+static int addrCount(int nNum)
+{
+	if((nNum >= 47 && nNum <= 81) || (nNum >= 92 && nNum <= 105) || (nNum >= 114 && nNum <= 118)
+			|| nNum == 142 || nNum == 143)
+		return MAX_SCANDINOVA_VACUUM_COUNT;
+	if((nNum >= 147 && nNum <= 152) || nNum == 157)
+		return SDN_VERIFY_COUNT;
+	if(nNum >= 158 && nNum <= 169)
+		return MAX_SCANDINOVA_SHADOW_COUNT;
+	return 0;
+}
+
+// A out of range for the @N, a mistyped substitution
+static int badAddr(int nNum, int nAddr)
+{
+	int nCount = addrCount(nNum);
+
+	return nCount > 0 && (nAddr < 0 || nAddr >= nCount);
+}
+
 static int convertAoData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 {
 	asynUser *pasynUser = pdpvt->pasynUser;
@@ -636,6 +1194,7 @@ static int convertAoData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 	
 	int nAddr,nDevIdx;
 	int nNum;
+	int i;
 	long lStatus = 0;
 	double dbVal;
 		
@@ -647,9 +1206,17 @@ static int convertAoData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 		return 0;
 
 	pAo->pact = TRUE;
+	if(badDevice(nDevIdx) || badAddr(nNum, nAddr))
+	{
+		recGblSetSevr(pAo, WRITE_ALARM, INVALID_ALARM);
+		pAo->pact = FALSE;
+		return 0;
+	}
 	switch(nNum)
 	{
-		case 60:	SDN[nDevIdx].SADI[nAddr].bUse = (int)pAo->val; break;
+		case 60:	SDN[nDevIdx].SADI[nAddr].bUse = (int)pAo->val;
+					startAutoDrive(nDevIdx, nAddr);
+					break;
 		case 61:	SDN[nDevIdx].SADI[nAddr].dbTripHighLimit = pAo->val; break;
 		case 62:	SDN[nDevIdx].SADI[nAddr].dbAlarmHighLimit = pAo->val; break;
 		case 63:	SDN[nDevIdx].SADI[nAddr].dbAlarmLowLimit = pAo->val; break;
@@ -662,6 +1229,44 @@ static int convertAoData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 		case 70:	SDN[nDevIdx].SADI[nAddr].dbAlarmDecreaseTime = pAo->val; break;
 		case 71:	SDN[nDevIdx].SADI[nAddr].dbHVTripGain = pAo->val; break;
 		case 72:	SDN[nDevIdx].SADI[nAddr].dbHVAlarmGain = pAo->val; break;
+		case 78:	SDN[nDevIdx].SADI[nAddr].bSettleUse = (int)pAo->val; break;
+		case 79:	SDN[nDevIdx].SADI[nAddr].dbSettleTolerance = pAo->val; break;
+		case 80:	SDN[nDevIdx].SADI[nAddr].dbSettleWindow = pAo->val; break;
+		case 81:	SDN[nDevIdx].SADI[nAddr].dbSettleVacuumBand = pAo->val; break;
+		case 100:	SDN[nDevIdx].SADI[nAddr].nRampMode = (int)pAo->val; break;
+		case 101:	SDN[nDevIdx].SADI[nAddr].dbAdaptSpeedMin = pAo->val; break;
+		case 102:	SDN[nDevIdx].SADI[nAddr].dbAdaptSpeedMax = pAo->val; break;
+		case 103:	SDN[nDevIdx].SADI[nAddr].dbAdaptHeadroomGain = pAo->val; break;
+		case 104:	SDN[nDevIdx].SADI[nAddr].dbAdaptArcGain = pAo->val; break;
+		case 105:	SDN[nDevIdx].SADI[nAddr].dbAdaptArcTau = pAo->val; break;
+		case 113:	SDN[nDevIdx].dbStaleLimit = pAo->val; break;
+		case 121:	recipeCommand(nDevIdx, (int)pAo->val); break;
+		case 137:	rampGroupSetBudget(nDevIdx, pAo->val, SDN[nDevIdx].SCH.dbDvBudget); break;
+		case 138:	rampGroupSetBudget(nDevIdx, SDN[nDevIdx].SCH.dbPowerBudget, pAo->val); break;
+		case 139:	scandinovaFaultReset(&SDN[nDevIdx].FFL);
+					scandinovaWordUpdate(nDevIdx);
+					break;
+		case 140:	SDN[nDevIdx].FFL.nMask = (int)pAo->val; break;
+		case 146:	scandinovaJitterReset(&portJitter[nDevIdx]);
+					for(i=0;i!=MAX_SCANDINOVA_VACUUM_COUNT;++i)
+						scandinovaJitterReset(&adStat[nDevIdx][i].JIT);
+					break;
+		case 153:	SDN[nDevIdx].dbVerifyTimeout = pAo->val; break;
+		case 155:	SDN[nDevIdx].nVerifyRetries = (int)pAo->val; break;
+		case 157:	scandinovaVerifyReset(&SDN[nDevIdx].VFY[nAddr]); break;
+		case 177:	scandinovaPollConfigure(nDevIdx, pAo->val, SDN[nDevIdx].POL.dbPhase); break;
+		case 178:	scandinovaPollConfigure(nDevIdx, SDN[nDevIdx].POL.dbPeriod, pAo->val); break;
+		case 158:	adShadow[nDevIdx][nAddr].bStarted = 0;		// forks again from the source
+					adShadow[nDevIdx][nAddr].bUse = (int)pAo->val;
+					break;
+		case 117:	SDN[nDevIdx].SADI[nAddr].dbStaleLimit = pAo->val; break;
+		case 118:	SDN[nDevIdx].SADI[nAddr].bStaleStandby = (int)pAo->val; break;
+		case 82:	if(hvSlewSetTarget(nDevIdx, pAo->val) > 0 && SDN[nDevIdx].HVS.bUse)
+						setHv(nDevIdx, pAo->val);		// decrease, not ramped
+					break;
+		case 83:	SDN[nDevIdx].HVS.dbSlewRate = pAo->val; break;
+		case 84:	SDN[nDevIdx].HVS.dbUpdateRate = pAo->val; break;
+		case 85:	SDN[nDevIdx].HVS.bUse = (int)pAo->val; break;
 	}
 
 	pAo->pact = FALSE;
@@ -671,6 +1276,12 @@ static int convertAoData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 	return 0;
 }
 
+// time to max hv records in hours, -1 stays -1
+static double shadowHours(double dbSec)
+{
+	return dbSec < 0 ? -1 : dbSec / 3600.0;
+}
+
 static int convertAiData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 {
 	asynUser *pasynUser = pdpvt->pasynUser;
@@ -685,6 +1296,7 @@ static int convertAiData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 	int nNum;
 	long lStatus = 0;
 	double dbVal;
+	int nPage;
 		
 	nDevIdx = pLink->value.gpibio.link;
 	nAddr = pLink->value.gpibio.addr;
@@ -694,6 +1306,12 @@ static int convertAiData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 		return 0;
 
 	pAi->pact = TRUE;
+	if(badDevice(nDevIdx) || badAddr(nNum, nAddr))
+	{
+		recGblSetSevr(pAi, READ_ALARM, INVALID_ALARM);
+		pAi->pact = FALSE;
+		return 0;
+	}
 
 	switch(nNum){
 		case 2:		dbVal = SDN[nDevIdx].dbStateSet; break;
@@ -744,11 +1362,93 @@ static int convertAiData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 		case 57:	dbVal = SDN[nDevIdx].SADI[nAddr].dbAlarmDecreaseTime; break;
 		case 58:	dbVal = SDN[nDevIdx].SADI[nAddr].dbHVTripGain; break;
 		case 59:	dbVal = SDN[nDevIdx].SADI[nAddr].dbHVAlarmGain; break;
+		case 73:	dbVal = SDN[nDevIdx].SADI[nAddr].bSettleUse; break;
+		case 74:	dbVal = SDN[nDevIdx].SADI[nAddr].dbSettleTolerance; break;
+		case 75:	dbVal = SDN[nDevIdx].SADI[nAddr].dbSettleWindow; break;
+		case 76:	dbVal = SDN[nDevIdx].SADI[nAddr].dbSettleVacuumBand; break;
+		case 77:	dbVal = SDN[nDevIdx].SADI[nAddr].bSettled; break;
+		case 92:	dbVal = SDN[nDevIdx].SADI[nAddr].nRampMode; break;
+		case 93:	dbVal = SDN[nDevIdx].SADI[nAddr].dbAdaptSpeedMin; break;
+		case 94:	dbVal = SDN[nDevIdx].SADI[nAddr].dbAdaptSpeedMax; break;
+		case 95:	dbVal = SDN[nDevIdx].SADI[nAddr].dbAdaptHeadroomGain; break;
+		case 96:	dbVal = SDN[nDevIdx].SADI[nAddr].dbAdaptArcGain; break;
+		case 97:	dbVal = SDN[nDevIdx].SADI[nAddr].dbAdaptArcTau; break;
+		case 98:	dbVal = SDN[nDevIdx].SADI[nAddr].dbAdaptSpeed; break;
+		case 99:	dbVal = SDN[nDevIdx].SADI[nAddr].dbArcRateFilt; break;
+		case 106:	dbVal = SDN[nDevIdx].dbTripLatency * 1000.0; break;
+		case 108:	case 109:	case 110:	case 111:
+					dbVal = pageAge(nDevIdx, nNum - 108); break;
+		case 112:	dbVal = SDN[nDevIdx].dbStaleLimit; break;
+		case 119:	dbVal = SDN[nDevIdx].dbStartupTime; break;
+		case 120:	dbVal = SDN[nDevIdx].bReady; break;
+		case 122:	dbVal = SDN[nDevIdx].RCP.nState; break;
+		case 123:	dbVal = SDN[nDevIdx].RCP.nStep + 1; break;
+		case 124:	dbVal = SDN[nDevIdx].RCP.nStepCount; break;
+		case 125:	dbVal = SDN[nDevIdx].RCP.dbProgress; break;
+		case 126:	dbVal = SDN[nDevIdx].RCP.dbEta; break;
+		case 127:	dbVal = SDN[nDevIdx].RCP.dbDwellDone; break;
+		case 128:	dbVal = SDN[nDevIdx].RCP.nBackoffs; break;
+		case 129:	dbVal = SDN[nDevIdx].SCH.nGroup; break;
+		case 130:	dbVal = SDN[nDevIdx].SCH.nRank; break;
+		case 131:	dbVal = SDN[nDevIdx].SCH.nGrants; break;
+		case 132:	dbVal = SDN[nDevIdx].SCH.nDefers; break;
+		case 133:	dbVal = SDN[nDevIdx].SCH.dbGroupPower; break;
+		case 134:	dbVal = SDN[nDevIdx].SCH.dbPowerBudget; break;
+		case 135:	dbVal = SDN[nDevIdx].SCH.dbDvLeft; break;
+		case 136:	dbVal = SDN[nDevIdx].SCH.dbDvBudget; break;
+		case 141:	dbVal = SDN[nDevIdx].FFL.nMask; break;
+		case 142:	dbVal = adStat[nDevIdx][nAddr].JIT.dbLast * 1000.0; break;
+		case 143:	dbVal = adStat[nDevIdx][nAddr].JIT.dbMax * 1000.0; break;
+		case 144:	dbVal = portJitter[nDevIdx].dbLast * 1000.0; break;
+		case 145:	dbVal = portJitter[nDevIdx].dbMax * 1000.0; break;
+		case 148:	dbVal = SDN[nDevIdx].VFY[nAddr].dbLatency * 1000.0; break;
+		case 149:	dbVal = SDN[nDevIdx].VFY[nAddr].dbLatencyMax * 1000.0; break;
+		case 150:	dbVal = SDN[nDevIdx].VFY[nAddr].nApplied; break;
+		case 151:	dbVal = SDN[nDevIdx].VFY[nAddr].nRetries; break;
+		case 152:	dbVal = SDN[nDevIdx].VFY[nAddr].nFailed; break;
+		case 154:	dbVal = SDN[nDevIdx].dbVerifyTimeout; break;
+		case 156:	dbVal = SDN[nDevIdx].nVerifyRetries; break;
+		case 170:	dbVal = SDN[nDevIdx].POL.dbPeriod; break;
+		case 171:	dbVal = SDN[nDevIdx].POL.dbPhaseUsed; break;
+		case 172:	dbVal = SDN[nDevIdx].POL.nPolls; break;
+		case 173:	dbVal = SDN[nDevIdx].POL.nOverruns; break;
+		case 174:	dbVal = SDN[nDevIdx].POL.nMissed; break;
+		case 175:	dbVal = SDN[nDevIdx].POL.dbLatency * 1000.0; break;
+		case 176:	dbVal = SDN[nDevIdx].POL.dbLatencyMax * 1000.0; break;
+		case 179:	dbVal = SDN[nDevIdx].POL.nNoReply; break;
+		case 159:	dbVal = adShadow[nDevIdx][nAddr].bUse; break;
+		case 160:	dbVal = adShadow[nDevIdx][nAddr].dbHvSet; break;
+		case 161:	dbVal = adShadow[nDevIdx][nAddr].dbHvSet - SDN[nDevIdx].dbHVPSVoltSet; break;
+		case 162:	dbVal = adShadow[nDevIdx][nAddr].sadi.nState; break;
+		case 163:	dbVal = adShadow[nDevIdx][nAddr].nMode; break;
+		case 164:	dbVal = adShadow[nDevIdx][nAddr].nTrips; break;
+		case 165:	dbVal = adShadow[nDevIdx][nAddr].nAlarms; break;
+		case 166:	dbVal = adShadow[nDevIdx][nAddr].nSteps; break;
+		case 167:	dbVal = adShadow[nDevIdx][nAddr].dbHoldTime / 60.0; break;
+		case 168:	dbVal = shadowHours(adShadow[nDevIdx][nAddr].dbTimeToMax); break;
+		case 169:	dbVal = shadowHours(adShadow[nDevIdx][nAddr].dbLiveTimeToMax); break;
+		case 114:	dbVal = SDN[nDevIdx].SADI[nAddr].dbStaleLimit; break;
+		case 115:	dbVal = SDN[nDevIdx].SADI[nAddr].bStaleStandby; break;
+		case 116:	dbVal = SDN[nDevIdx].SADI[nAddr].bStale; break;
+		case 107:	dbVal = SDN[nDevIdx].nFastTrips; break;
+		case 86:	dbVal = SDN[nDevIdx].HVS.dbTarget; break;
+		case 87:	dbVal = SDN[nDevIdx].HVS.dbSlewRate; break;
+		case 88:	dbVal = SDN[nDevIdx].HVS.dbUpdateRate; break;
+		case 89:	dbVal = SDN[nDevIdx].HVS.dbPoint; break;
+		case 90:	dbVal = SDN[nDevIdx].HVS.nCoalesced; break;
+		case 91:	dbVal = SDN[nDevIdx].HVS.bUse; break;
 			
 	}
 
 	pAi->val = dbVal;
 
+	nPage = pageOfParam(nNum);
+	if(nPage >= 0 && pageAge(nDevIdx, nPage) > SDN[nDevIdx].dbStaleLimit)
+		recGblSetSevr(pAi, READ_ALARM, INVALID_ALARM);
+	// TSE=-2: every value of one frame carries the receive time of that frame
+	if(nPage >= 0 && nNum < 108 && pAi->tse == epicsTimeEventDeviceTime)
+		frameTimeStamp(nDevIdx, nPage, &pAi->time);
+
 	pAi->pact = FALSE;
 
 	if(RTN_SUCCESS(lStatus))
@@ -768,24 +1468,39 @@ static int convertMbbiData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 	unsigned char pact = pMbbi->pact;
 	
 	int nAddr;
+	int nDevIdx;
 	int nNum;
+	int nPage;
 	long lStatus = 0;
-	double dbVal;
+	double dbVal = 0;
 		
 	nAddr = pLink->value.gpibio.addr;
+	nDevIdx = pLink->value.gpibio.link;
 	sscanf(pLink->value.gpibio.parm,"%d",&nNum);
 	
 	if(!pact && pMbbi->pact)
 		return 0;
 
 	pMbbi->pact = TRUE;
+	if(badDevice(nDevIdx) || badAddr(nNum, nAddr))
+	{
+		recGblSetSevr(pMbbi, READ_ALARM, INVALID_ALARM);
+		pMbbi->pact = FALSE;
+		return 0;
+	}
 
 	switch(nNum){
 		//case 18:	dbVal = SDN[nAddr].dbRemainingTime; break;
+		case 33:	dbVal = SDN[nDevIdx].dbControlWordSet; break;
+		case 147:	dbVal = SDN[nDevIdx].VFY[nAddr].nStatus; break;
 	}
 
 	pMbbi->val = (int)dbVal;
 
+	nPage = pageOfParam(nNum);
+	if(nPage >= 0 && pMbbi->tse == epicsTimeEventDeviceTime)
+		frameTimeStamp(nDevIdx, nPage, &pMbbi->time);
+
 	pMbbi->pact = FALSE;
 
 	if(RTN_SUCCESS(lStatus))
@@ -796,95 +1511,109 @@ static int convertMbbiData(struct gpibDpvt *pdpvt, int P1, int P2, char **P3)
 
 static void runAutoDriveThreadFunc(void *lParam)
 {
-	int i;
-	double dbTemp;
 	SCANDINOVA_AUTO_DRIVE_INFO *p = (SCANDINOVA_AUTO_DRIVE_INFO*)lParam;
+	AD_THREAD_STAT *pStat = &adStat[p->nParentId][p->nIdx];
+	AD_FAST_EVENT *pFast = &adFast[p->nParentId][p->nIdx];
+	SCANDINOVA_AD_SAMPLE smp[AD_SAMPLE_QUEUE];
+	int nSmp;
+	int bMaxPoint;
+	double dbMaxPoint;
+	int bTrip;
+	double dbTripHv;
+	double dbSignal;
+	double dbStart;
+	double dbBusy;
+	double dbHv;
+	double dbWait;
+	double dbScheduled;
+	int nState;
+	int i;
 
-	epicsThreadSleep(5);
-
+	pStat->dbStart = liveGetTime(NULL);
 	while(1)
 	{
-		if(p->bUse == 0)
+		dbStart = liveGetTime(NULL);
+		nState = p->nState;
+		dbHv = p->dbCommandedHv;
+
+		epicsMutexMustLock(adFastLock);
+		bTrip = pFast->bTripPending;
+		dbTripHv = pFast->dbTripHv;
+		pFast->bTripPending = 0;
+		for(nSmp=0;nSmp!=pFast->nSmpCount;++nSmp)
+			smp[nSmp] = pFast->SMP[(pFast->nSmpHead + nSmp) % AD_SAMPLE_QUEUE];
+		pFast->nSmpHead = 0;
+		pFast->nSmpCount = 0;
+		bMaxPoint = pFast->bMaxPointPending;
+		dbMaxPoint = pFast->dbMaxPoint;
+		pFast->bMaxPointPending = 0;
+		epicsMutexUnlock(adFastLock);
+		if(bMaxPoint)
+			p->dbHVMaxPoint = dbMaxPoint;
+		for(i=0;i!=nSmp;++i)
+			autoDriveSample(p,&smp[i]);
+		if(bTrip)
+			autoDriveFastTrip(p,dbTripHv);
+		autoDriveProcess(p,&liveOps);
+		for(i=0;i!=MAX_SCANDINOVA_SHADOW_COUNT;++i)
 		{
-			epicsThreadSleep(1);
-			continue;
+			if(adShadow[p->nParentId][i].nSource == p->nIdx)
+				autoDriveShadowProcess(&adShadow[p->nParentId][i],p,&SDN[p->nParentId],liveGetTime(NULL));
 		}
+		dbBusy = liveGetTime(NULL) - dbStart;
+		pStat->dbBusy += dbBusy;
+		pStat->dbBusyMax = fmax(pStat->dbBusyMax, dbBusy);
+		++pStat->nLoops;
 
-		// hardware interlock reset
-		if((int)SDN[p->nParentId].dbStateRead != 0xD000)
+		if(scandinovaTraceMask & SDN_TRACE_AUTODRIVE)
 		{
-			epicsThreadSleep(p->dbTripBlockingTime);
-			hwControlSet(p->nParentId,0x0001);
-			epicsThreadSleep(5);
-			if((int)SDN[p->nParentId].dbStateRead == 0x06000)
-			{
-				setHv(p->nParentId,300.0);
-				epicsThreadSleep(5);
-				changeMode(p->nParentId,0x0D000);
-			}
+			if(p->nState != nState)
+				epicsPrintf("autoDrive[%d][%d]: state %d -> %d\n",p->nParentId,p->nIdx,nState,p->nState);
+			if(p->dbCommandedHv != dbHv)
+				epicsPrintf("autoDrive[%d][%d]: hv step %.2f -> %.2f\n",p->nParentId,p->nIdx,dbHv,p->dbCommandedHv);
 		}
 
-		//epicsPrintf("\n##### vacuum: %.2f\n\n",*p->dbVacuum);
-
-		if(*p->dbVacuum>=p->dbTripHighLimit)			// no.3 section (trip high limit)
-		{
-			p->bOnArcing = 1;
-			p->bOnMidPoint = 1;
-			p->dbMidPoint = SDN[p->nParentId].dbHVPSVoltRead * p->dbHVTripGain / 100.0;
-			changeMode(p->nParentId, 0x0A000);
-			//epicsPrintf("[SCANDINOVA AUTODRIVE] Trip High limit\n");
-		}
-		else if(*p->dbVacuum >= p->dbAlarmHighLimit)	// no.1 section (s/w alarm high limit)
-		{
-			dbTemp = SDN[p->nParentId].dbHVPSVoltRead * p->dbHVAlarmGain / 100.0;
-			setHv(p->nParentId, dbTemp);
-			//epicsPrintf("alarmdecresetime sleep: %.2f\n",p->dbAlarmDecreaseTime);
-			epicsThreadSleep(p->dbAlarmDecreaseTime);	// (unit: sec)
-			p->bOnAlarm = 1;
-			//epicsPrintf("[SCANDINOVA AUTODRIVE] alarm High limit\n");
-			//epicsPrintf("volt: %.2f\tgain: %.2f\t:setpoint: %.2f\n",SDN[p->nParentId].dbHVPSVoltRead,p->dbHVAlarmGain,dbTemp);
-		}
-		else if(*p->dbVacuum >= p->dbAlarmLowLimit)		// normal section
-		{
-			if(p->bOnArcing == 0 && p->bOnAlarm == 0)
-				increaseHv(p);	// 
-			//epicsPrintf("[SCANDINOVA AUTODRIVE] normal\n");
-		}
-		else if(*p->dbVacuum >= p->dbTripLowLimit)		// no.2 section (s/w alarm low limit)
-		{
-			//epicsPrintf("[SCANDINOVA AUTODRIVE] alarm low limit\n");
-			if(p->bOnAlarm == 1)
-			{
-				//epicsPrintf("alarmblockingtime sleep: %.2f\n",p->dbAlarmBlockingTime);
-				epicsThreadSleep(p->dbAlarmBlockingTime);
-				p->bOnAlarm = 0;
-			}
-			if(p->bOnAlarm == 0 && p->bOnArcing == 0)
-				increaseHv(p);
-		}
-		else											// no.4 section (h/w trip low limit)
+		dbWait = liveGetTime(NULL);
+		if(epicsEventWaitWithTimeout(adWakeEvent[p->nParentId][p->nIdx],AD_THREAD_PERIOD) == epicsEventWaitOK)
 		{
-			//epicsPrintf("[SCANDINOVA AUTODRIVE] trip low limit\n");
-			if(p->bOnArcing == 1)
-			{
-				p->bOnArcing = 0;
-				changeMode(p->nParentId, 0x0d000);
-				increaseHv(p);
-			}
-			else
-				increaseHv(p);
+			epicsMutexMustLock(adFastLock);
+			dbSignal = pFast->dbSignalTime;
+			epicsMutexUnlock(adFastLock);
+			dbScheduled = fmax(dbSignal,dbWait);
 		}
+		else
+			dbScheduled = dbWait + AD_THREAD_PERIOD;
+		scandinovaJitterSample(&pStat->JIT,dbScheduled,liveGetTime(NULL));
+	}
+}
 
-		//epicsPrintf("Thread... [%d][%d] : %.2f - %.2f - %.2f\n",p->nParentId,p->nIdx
-		//		,p->dbTripHighLimit,*p->dbVacuum,p->dbTripLowLimit);
-		epicsThreadSleep(1);
+/*
+ * Commands go through the records of the modulator, "dbpf <prefix><record>";
+ * a modulator without a prefix is not commanded.
+ */
+static const char *devicePrefix(int nDevIdx)
+{
+	if(badDevice(nDevIdx))
+		return NULL;
+	if(devPrefix[nDevIdx][0] == '\0')
+	{
+		if(bPrefixWarned[nDevIdx] == 0)
+			epicsPrintf("devSCANDINOVA[%d]: no record prefix, no commands (scandinovaDeviceConfigure)\n",nDevIdx);
+		bPrefixWarned[nDevIdx] = 1;
+		return NULL;
 	}
+	return devPrefix[nDevIdx];
 }
 
 int changeMode(int nDevIdx, int nMode)
 {
+	const char *strPrefix;
 	char strCmd[256];
-	sprintf(strCmd,"dbpf FEL:ATF03:LO_STATE_SET %d",nMode);
+	if((strPrefix = devicePrefix(nDevIdx)) == NULL)
+		return 0;
+	sprintf(strCmd,"dbpf %sLO_STATE_SET %d",strPrefix,nMode);
+	if(scandinovaTraceMask & SDN_TRACE_COMMAND)
+		epicsPrintf("devSCANDINOVA[%d]: %s\n",nDevIdx,strCmd);
 	iocshCmd(strCmd);
 
 	//epicsPrintf("state change. %X\n",nMode);
@@ -892,8 +1621,18 @@ int changeMode(int nDevIdx, int nMode)
 }
 int setHv(int nDevIdx, double dbSetpoint)
 { 
+	const char *strPrefix;
 	char strCmd[256];
-	sprintf(strCmd,"dbpf FEL:ATF03:AO_HVPS_VOLT_SETPOINT %.2f",dbSetpoint);
+
+	// smooth ramp through the slew generator when it is enabled, decreases are written at once
+	if(SDN[nDevIdx].HVS.bUse && hvSlewSetTarget(nDevIdx, dbSetpoint) == 0)
+		return 1;
+
+	if((strPrefix = devicePrefix(nDevIdx)) == NULL)
+		return 0;
+	sprintf(strCmd,"dbpf %sAO_HVPS_VOLT_SETPOINT %.2f",strPrefix,dbSetpoint);
+	if(scandinovaTraceMask & SDN_TRACE_COMMAND)
+		epicsPrintf("devSCANDINOVA[%d]: %s\n",nDevIdx,strCmd);
 	iocshCmd(strCmd);
 	
 	//epicsPrintf("setpoint change. %.2f\n",dbSetpoint);
@@ -901,113 +1640,305 @@ int setHv(int nDevIdx, double dbSetpoint)
 }
 int hwControlSet(int nDevIdx, int nMode)
 {
+	const char *strPrefix;
 	char strCmd[256];
-	sprintf(strCmd,"dbpf FEL:ATF03:MBO_CONTROL_WORD_SET %d",nMode);
+	if((strPrefix = devicePrefix(nDevIdx)) == NULL)
+		return 0;
+	sprintf(strCmd,"dbpf %sMBO_CONTROL_WORD_SET %d",strPrefix,nMode);
+	if(scandinovaTraceMask & SDN_TRACE_COMMAND)
+		epicsPrintf("devSCANDINOVA[%d]: %s\n",nDevIdx,strCmd);
 	iocshCmd(strCmd);
 	
 	//epicsPrintf("setpoint change. %.2f\n",dbSetpoint);
 	return 1;
 }
-int increaseHv(SCANDINOVA_AUTO_DRIVE_INFO *p)
+int prfSet(int nDevIdx, int nPrf)
 {
-	double dbOffset;
-	double dbSub;
+	const char *strPrefix;
 	char strCmd[256];
-	epicsTimeStamp tNow;
-	
-	// only master
-	if(p->nPriority == SLAVE)
-		return 1;
+	if((strPrefix = devicePrefix(nDevIdx)) == NULL)
+		return 0;
+	sprintf(strCmd,"dbpf %sLO_PRF_SET %d",strPrefix,nPrf);
+	if(scandinovaTraceMask & SDN_TRACE_COMMAND)
+		epicsPrintf("devSCANDINOVA[%d]: %s\n",nDevIdx,strCmd);
+	iocshCmd(strCmd);
+	return 1;
+}
+/*
+ * Max point of an auto drive channel from another thread (recipe): the auto
+ * drive thread takes it before its next autoDriveProcess, a channel without
+ * a thread is set directly.
+ */
+void scandinovaSetMaxPoint(int nDevIdx, int nIdx, double dbMaxPoint)
+{
+	AD_FAST_EVENT *pFast;
+
+	if(badDevice(nDevIdx) || nIdx < 0 || nIdx >= MAX_SCANDINOVA_VACUUM_COUNT)
+		return;
+	pFast = &adFast[nDevIdx][nIdx];
+	epicsMutexMustLock(adFastLock);
+	if(adThread[nDevIdx][nIdx] == NULL)
+		SDN[nDevIdx].SADI[nIdx].dbHVMaxPoint = dbMaxPoint;
+	else
+	{
+		pFast->bMaxPointPending = 1;
+		pFast->dbMaxPoint = dbMaxPoint;
+	}
+	epicsMutexUnlock(adFastLock);
+	if(adThread[nDevIdx][nIdx] != NULL)
+		epicsEventSignal(adWakeEvent[nDevIdx][nIdx]);
+}
 
-	dbOffset = 2;
+// the max point in effect once a pending scandinovaSetMaxPoint is taken
+double scandinovaMaxPoint(int nDevIdx, int nIdx)
+{
+	AD_FAST_EVENT *pFast = &adFast[nDevIdx][nIdx];
+	double dbMaxPoint;
 
-	// time check 
-	epicsTimeGetCurrent(&tNow);
-	dbSub = epicsTimeDiffInSeconds(&tNow,&p->tLastIncrease);
-	if(SDN[p->nParentId].dbHVPSVoltRead <= 1000)
+	epicsMutexMustLock(adFastLock);
+	dbMaxPoint = pFast->bMaxPointPending ? pFast->dbMaxPoint : SDN[nDevIdx].SADI[nIdx].dbHVMaxPoint;
+	epicsMutexUnlock(adFastLock);
+	return dbMaxPoint;
+}
+
+int plswthSet(int nDevIdx, double dbPlswth)
+{
+	const char *strPrefix;
+	char strCmd[256];
+	if((strPrefix = devicePrefix(nDevIdx)) == NULL)
+		return 0;
+	sprintf(strCmd,"dbpf %sAO_PLSWTH_SET %.4f",strPrefix,dbPlswth);
+	if(scandinovaTraceMask & SDN_TRACE_COMMAND)
+		epicsPrintf("devSCANDINOVA[%d]: %s\n",nDevIdx,strCmd);
+	iocshCmd(strCmd);
+	return 1;
+}
+
+/******************************************************************************
+ * Diagnostics: scandinovaReport(level) and dbior
+ *
+ * level 0: one line per modulator
+ * level 1: + ping pages and auto drive channels
+ * level 2: + worker threads and queues
+ *****************************************************************************/
+static void reportTime(double dbTime, char *strTime, int nLen)
+{
+	epicsTimeStamp tStamp;
+
+	if(dbTime <= 0)
 	{
-		if(p->bOnMidPoint == 1)
-		{
-			if(dbSub >= 10.0
-					&& SDN[p->nParentId].dbHVPSVoltRead >= SDN[p->nParentId].dbHVPSVoltSet-dbOffset
-					&& SDN[p->nParentId].dbHVPSVoltRead < p->dbMidPoint-dbOffset)
-			{
-				sprintf(strCmd,"dbpf FEL:ATF03:AO_HVPS_VOLT_SETPOINT %.2f",fmin(SDN[p->nParentId].dbHVPSVoltSet + 10.0,p->dbHVMaxPoint));
-				iocshCmd(strCmd);
-				epicsTimeGetCurrent(&p->tLastIncrease);
-				//epicsPrintf("increase hv : %.2f\n",fmin(SDN[p->nParentId].dbHVPSVoltSet + p->dbHVRampSpeed,p->dbHVMaxPoint));
-			}
-			else
-			{
-				//epicsPrintf("tripblockingtime sleep: %.2f\n",p->dbTripBlockingTime);
-				epicsThreadSleep(p->dbTripBlockingTime);
-				p->bOnMidPoint = 0;
-			}
-		}
-		else
-		{
-			if(dbSub >= 10.0
-					&& SDN[p->nParentId].dbHVPSVoltRead >= SDN[p->nParentId].dbHVPSVoltSet-dbOffset
-					&& SDN[p->nParentId].dbHVPSVoltRead < p->dbHVMaxPoint-dbOffset)
-			{
-				sprintf(strCmd,"dbpf FEL:ATF03:AO_HVPS_VOLT_SETPOINT %.2f",fmin(SDN[p->nParentId].dbHVPSVoltSet + 10.0,p->dbHVMaxPoint));
-				iocshCmd(strCmd);
-				epicsTimeGetCurrent(&p->tLastIncrease);
-				//epicsPrintf("increase hv : %.2f\n",fmin(SDN[p->nParentId].dbHVPSVoltSet + p->dbHVRampSpeed,p->dbHVMaxPoint));
-			}
-			else
-			{
-				//epicsPrintf("increaseHv failure.\n");
-				//epicsPrintf("dbSub: %f\n",dbSub);
-				//epicsPrintf("dbHVRampSpeed: %f\n", p->dbHVRampSpeed);
-				//epicsPrintf("dbHVPSVoltRead: %f\n",SDN[p->nParentId].dbHVPSVoltRead);
-				//epicsPrintf("dbHVPSVoltSet: %f\n",SDN[p->nParentId].dbHVPSVoltSet);
-				//epicsPrintf("dbHVMaxPoint: %f\n",p->dbHVMaxPoint);
-			}
-		}
+		strcpy(strTime,"never");
+		return;
 	}
-	else
+	tStamp.secPastEpoch = (epicsUInt32)dbTime;
+	tStamp.nsec = (epicsUInt32)((dbTime - tStamp.secPastEpoch) * 1e9);
+	epicsTimeToStrftime(strTime,nLen,"%Y/%m/%d %H:%M:%S.%03f",&tStamp);
+}
+
+static void reportThread(const char *strName, epicsThreadId thread)
+{
+	if(thread == NULL)
 	{
-		if(p->bOnMidPoint == 1)
-		{
-			if(dbSub >= p->dbHVRampCheckTime
-					&& SDN[p->nParentId].dbHVPSVoltRead >= SDN[p->nParentId].dbHVPSVoltSet-dbOffset
-					&& SDN[p->nParentId].dbHVPSVoltRead < p->dbMidPoint-dbOffset)
-			{
-				sprintf(strCmd,"dbpf FEL:ATF03:AO_HVPS_VOLT_SETPOINT %.2f",fmin(SDN[p->nParentId].dbHVPSVoltSet + p->dbHVRampSpeed,p->dbHVMaxPoint));
-				iocshCmd(strCmd);
-				epicsTimeGetCurrent(&p->tLastIncrease);
-				//epicsPrintf("increase hv : %.2f\n",fmin(SDN[p->nParentId].dbHVPSVoltSet + p->dbHVRampSpeed,p->dbHVMaxPoint));
-			}
-			else
-			{
-				//epicsPrintf("tripblockingtime sleep: %.2f\n",p->dbTripBlockingTime);
-				epicsThreadSleep(p->dbTripBlockingTime);
-				p->bOnMidPoint = 0;
-			}
-		}
-		else
-		{
-			if(dbSub >= p->dbHVRampCheckTime
-					&& SDN[p->nParentId].dbHVPSVoltRead >= SDN[p->nParentId].dbHVPSVoltSet-dbOffset
-					&& SDN[p->nParentId].dbHVPSVoltRead < p->dbHVMaxPoint-dbOffset)
-			{
-				sprintf(strCmd,"dbpf FEL:ATF03:AO_HVPS_VOLT_SETPOINT %.2f",fmin(SDN[p->nParentId].dbHVPSVoltSet + p->dbHVRampSpeed,p->dbHVMaxPoint));
-				iocshCmd(strCmd);
-				epicsTimeGetCurrent(&p->tLastIncrease);
-				//epicsPrintf("increase hv : %.2f\n",fmin(SDN[p->nParentId].dbHVPSVoltSet + p->dbHVRampSpeed,p->dbHVMaxPoint));
-			}
-			else
-			{
-				//epicsPrintf("increaseHv failure.\n");
-				//epicsPrintf("dbSub: %f\n",dbSub);
-				//epicsPrintf("dbHVRampSpeed: %f\n", p->dbHVRampSpeed);
-				//epicsPrintf("dbHVPSVoltRead: %f\n",SDN[p->nParentId].dbHVPSVoltRead);
-				//epicsPrintf("dbHVPSVoltSet: %f\n",SDN[p->nParentId].dbHVPSVoltSet);
-				//epicsPrintf("dbHVMaxPoint: %f\n",p->dbHVMaxPoint);
-			}
-		}
+		printf("      %-20s not started\n",strName);
+		return;
 	}
+	printf("      %-20s priority %u%s\n",strName,epicsThreadGetPriority(thread),
+			epicsThreadIsSuspended(thread) ? ", SUSPENDED" : "");
+}
 
-	return 1;
+static void reportDevice(int nDevIdx, int nLevel)
+{
+	SCANDINOVA_INFO *pInfo = &SDN[nDevIdx];
+	SCANDINOVA_AUTO_DRIVE_INFO *p;
+	SCANDINOVA_PAGE_DIAG *pDiag;
+	SCANDINOVA_VERIFY_INFO *pVfy;
+	SCANDINOVA_SHADOW_INFO *pShd;
+	AD_THREAD_STAT *pStat;
+	char strTime[64];
+	char thName[64];
+	double dbNow = liveGetTime(NULL);
+	double dbElapsed;
+	int nErrors = 0;
+	int i;
+
+	for(i=0;i!=MAX_SCANDINOVA_PAGE_COUNT;++i)
+		nErrors += pInfo->PGD[i].nParseErrors;
+	printf("SCANDINOVA %d: %s, state 0x%04X, hv %.2f/%.2f V, frames %d, parse errors %d, startup %.3f sec\n",
+			nDevIdx,pInfo->bReady ? "ready" : "no data",(int)pInfo->dbStateRead,pInfo->dbHVPSVoltRead,pInfo->dbHVPSVoltSet,
+			pInfo->PGD[0].nFrames,nErrors,pInfo->dbStartupTime);
+	if(nLevel < 1)
+		return;
+
+	printf("  page  last frame                 age[s] frames errors  interval last/min/mean/max[s]  latency last/max[ms]\n");
+	for(i=0;i!=MAX_SCANDINOVA_PAGE_COUNT;++i)
+	{
+		pDiag = &pInfo->PGD[i];
+		reportTime(pInfo->dbPageTime[i],strTime,sizeof(strTime));
+		printf("  %4d  %-26s %6.1f %6d %6d  %6.3f/%6.3f/%6.3f/%6.3f  %8.1f/%8.1f\n",i,strTime,
+				pInfo->dbPageTime[i] > 0 ? dbNow - pInfo->dbPageTime[i] : -1,pDiag->nFrames,pDiag->nParseErrors,
+				pDiag->dbInterval,pDiag->dbIntervalMin,
+				pDiag->nFrames > 1 ? pDiag->dbIntervalSum / (pDiag->nFrames - 1) : 0,pDiag->dbIntervalMax,
+				pDiag->dbLatency * 1e3,pDiag->dbLatencyMax * 1e3);
+	}
+	printf("  poll: %s, period %.3f sec, phase %.3f sec, polls %d, overruns %d, no reply %d, missed %d, latency last/max %.1f/%.1f ms\n",
+			pInfo->POL.bUse ? "scheduled" : "no POLL_TICK record",pInfo->POL.dbPeriod,pInfo->POL.dbPhaseUsed,
+			pInfo->POL.nPolls,pInfo->POL.nOverruns,pInfo->POL.nNoReply,pInfo->POL.nMissed,pInfo->POL.dbLatency * 1e3,pInfo->POL.dbLatencyMax * 1e3);
+	printf("  fast trips %d, last trip latency %.1f ms, stale limit %.1f sec\n",
+			pInfo->nFastTrips,pInfo->dbTripLatency * 1e3,pInfo->dbStaleLimit);
+	for(i=0;i!=SDN_VERIFY_COUNT;++i)
+	{
+		pVfy = &pInfo->VFY[i];
+		printf("  %s writes: %s %g, applied %d, retries %d, failed %d, latency last/max %.1f/%.1f ms\n",
+				verifyName[i],verifyStatus[pVfy->nStatus],pVfy->dbValue,pVfy->nApplied,pVfy->nRetries,pVfy->nFailed,
+				pVfy->dbLatency * 1e3,pVfy->dbLatencyMax * 1e3);
+	}
+
+	for(i=0;i!=MAX_SCANDINOVA_VACUUM_COUNT;++i)
+	{
+		p = &pInfo->SADI[i];
+		if(p->bUse == 0 && nLevel < 2)
+			continue;
+		printf("  auto drive %d: %s, state %d, hold %.1f sec, vacuum %.3e, max %.2f V, midpoint %s%.2f V,"
+				" last step %.2f V %.1f sec ago%s%s%s\n",
+				i,p->bUse ? "on" : "off",p->nState,
+				p->dbHoldUntil > dbNow ? p->dbHoldUntil - dbNow : 0,
+				p->dbVacuum ? *p->dbVacuum : 0,p->dbHVMaxPoint,p->bOnMidPoint ? "" : "(off) ",p->dbMidPoint,
+				p->dbCommandedHv,p->dbLastIncrease > 0 ? dbNow - p->dbLastIncrease : -1,
+				p->bOnArcing ? ", arcing" : "",p->bOnAlarm ? ", alarm" : "",p->bStale ? ", STALE" : "");
+	}
+	for(i=0;i!=MAX_SCANDINOVA_SHADOW_COUNT;++i)
+	{
+		pShd = &adShadow[nDevIdx][i];
+		if(pShd->bUse == 0)
+			continue;
+		printf("  shadow %d of auto drive %d: %d overrides, state %d, hv %.2f V (live %+.2f V), steps %d, trips %d,"
+				" alarms %d, hold %.1f min, time to max %.2f h (live %.2f h)\n",
+				i,pShd->nSource,pShd->nParams,pShd->sadi.nState,pShd->dbHvSet,pShd->dbHvSet - pInfo->dbHVPSVoltSet,
+				pShd->nSteps,pShd->nTrips,pShd->nAlarms,pShd->dbHoldTime / 60.0,
+				shadowHours(pShd->dbTimeToMax),shadowHours(pShd->dbLiveTimeToMax));
+	}
+	if(nLevel < 2)
+		return;
+
+	printf("    threads and queues:\n");
+	for(i=0;i!=MAX_SCANDINOVA_VACUUM_COUNT;++i)
+	{
+		sprintf(thName,"AUTODRIVE#%d_%d",nDevIdx,i);
+		reportThread(thName,adThread[nDevIdx][i]);
+		if(adThread[nDevIdx][i] == NULL)
+			continue;
+		pStat = &adStat[nDevIdx][i];
+		dbElapsed = dbNow - pStat->dbStart;
+		printf("        loops %d, busy %.3f%%, max loop %.3f ms, wakeup jitter last/mean/max %.3f/%.3f/%.3f ms\n",pStat->nLoops,
+				dbElapsed > 0 ? pStat->dbBusy / dbElapsed * 100 : 0,pStat->dbBusyMax * 1e3,
+				pStat->JIT.dbLast * 1e3,pStat->JIT.nWakeups ? pStat->JIT.dbSum / pStat->JIT.nWakeups * 1e3 : 0,pStat->JIT.dbMax * 1e3);
+	}
+	printf("      port: ping 0 jitter last/mean/max %.3f/%.3f/%.3f ms\n",portJitter[nDevIdx].dbLast * 1e3,
+			portJitter[nDevIdx].nWakeups ? portJitter[nDevIdx].dbSum / portJitter[nDevIdx].nWakeups * 1e3 : 0,
+			portJitter[nDevIdx].dbMax * 1e3);
+	printf("      hv slew: %s, %s, target %.2f V, point %.2f V, coalesced writes %d, dropped %d\n",
+			pInfo->HVS.bUse ? "on" : "off",pInfo->HVS.bActive ? "active" : "idle",
+			pInfo->HVS.dbTarget,pInfo->HVS.dbPoint,pInfo->HVS.nCoalesced,pInfo->HVS.nDropped);
+	printf("      recipe: state %d, step %d/%d, ramp group %d rank %d, grants %d, defers %d\n",
+			pInfo->RCP.nState,pInfo->RCP.nStep + 1,pInfo->RCP.nStepCount,
+			pInfo->SCH.nGroup,pInfo->SCH.nRank,pInfo->SCH.nGrants,pInfo->SCH.nDefers);
+}
+
+int scandinovaReport(int nLevel)
+{
+	int nDevIdx;
+
+	printf("trace mask 0x%04X\n",scandinovaTraceMask);
+	for(nDevIdx=0;nDevIdx!=MAX_SCANDINOVA_CNT;++nDevIdx)
+	{
+		if(SDN[nDevIdx].bPresent)
+			reportDevice(nDevIdx,nLevel);
+	}
+	return 0;
+}
+
+// dbior
+static long drvSCANDINOVAReport_report(int nLevel)
+{
+	return scandinovaReport(nLevel);
+}
+
+drvet drvSCANDINOVAReport = {
+	2,
+	(DRVSUPFUN)drvSCANDINOVAReport_report,
+	NULL
+};
+epicsExportAddress(drvet, drvSCANDINOVAReport);
+
+/* iocsh: scandinovaReport(level) */
+static const iocshArg scandinovaReportArg0 = {"level", iocshArgInt};
+static const iocshArg * const scandinovaReportArgs[] = {&scandinovaReportArg0};
+static const iocshFuncDef scandinovaReportDef = {"scandinovaReport", 1, scandinovaReportArgs};
+
+static void scandinovaReportCall(const iocshArgBuf *args)
+{
+	scandinovaReport(args[0].ival);
+}
+
+static void scandinovaReportRegister(void)
+{
+	iocshRegister(&scandinovaReportDef, scandinovaReportCall);
+}
+epicsExportRegistrar(scandinovaReportRegister);
+
+/* iocsh: scandinovaDeviceConfigure(dev, prefix) */
+static const iocshArg scandinovaDeviceConfigureArg0 = {"dev", iocshArgInt};
+static const iocshArg scandinovaDeviceConfigureArg1 = {"prefix", iocshArgString};
+static const iocshArg * const scandinovaDeviceConfigureArgs[] = {
+	&scandinovaDeviceConfigureArg0, &scandinovaDeviceConfigureArg1};
+static const iocshFuncDef scandinovaDeviceConfigureDef = {"scandinovaDeviceConfigure", 2, scandinovaDeviceConfigureArgs};
+
+static void scandinovaDeviceConfigureCall(const iocshArgBuf *args)
+{
+	int nDevIdx = args[0].ival;
+
+	if(badDevice(nDevIdx) || args[1].sval == NULL)
+	{
+		epicsPrintf("scandinovaDeviceConfigure: device 0 ~ %d and a record prefix are required\n",MAX_SCANDINOVA_CNT-1);
+		return;
+	}
+	strncpy(devPrefix[nDevIdx],args[1].sval,sizeof(devPrefix[nDevIdx])-1);
+	devPrefix[nDevIdx][sizeof(devPrefix[nDevIdx])-1] = '\0';
+	bPrefixWarned[nDevIdx] = 0;
+}
+
+static void scandinovaDeviceRegister(void)
+{
+	iocshRegister(&scandinovaDeviceConfigureDef, scandinovaDeviceConfigureCall);
+}
+epicsExportRegistrar(scandinovaDeviceRegister);
+
+/* iocsh: scandinovaShadowConfigure(dev, shadow, source, params) */
+static const iocshArg scandinovaShadowConfigureArg0 = {"dev", iocshArgInt};
+static const iocshArg scandinovaShadowConfigureArg1 = {"shadow", iocshArgInt};
+static const iocshArg scandinovaShadowConfigureArg2 = {"source", iocshArgInt};
+static const iocshArg scandinovaShadowConfigureArg3 = {"params", iocshArgString};
+static const iocshArg * const scandinovaShadowConfigureArgs[] = {
+	&scandinovaShadowConfigureArg0, &scandinovaShadowConfigureArg1, &scandinovaShadowConfigureArg2, &scandinovaShadowConfigureArg3};
+static const iocshFuncDef scandinovaShadowConfigureDef = {"scandinovaShadowConfigure", 4, scandinovaShadowConfigureArgs};
+
+static void scandinovaShadowConfigureCall(const iocshArgBuf *args)
+{
+	int nDevIdx = args[0].ival;
+	int nShadow = args[1].ival;
+
+	if(nDevIdx < 0 || nDevIdx >= MAX_SCANDINOVA_CNT || nShadow < 0 || nShadow >= MAX_SCANDINOVA_SHADOW_COUNT)
+	{
+		epicsPrintf("scandinovaShadowConfigure: bad device %d or shadow %d\n",nDevIdx,nShadow);
+		return;
+	}
+	if(autoDriveShadowConfigure(&adShadow[nDevIdx][nShadow],args[2].ival,args[3].sval) != 0)
+		epicsPrintf("scandinovaShadowConfigure: bad source %d or parameters \"%s\"\n",args[2].ival,
+				args[3].sval ? args[3].sval : "");
+}
+
+static void scandinovaShadowRegister(void)
+{
+	iocshRegister(&scandinovaShadowConfigureDef, scandinovaShadowConfigureCall);
 }
+epicsExportRegistrar(scandinovaShadowRegister);
@@ -1,17 +1,45 @@
 #ifndef DEVSCANDINOVA_H
 #define DEVSCANDINOVA_H
 
-#define MAX_SCANDINOVA_CNT				1
+#define MAX_SCANDINOVA_CNT				8	// modulators of one IOC, links L0 ~ L7
 #define MAX_SCANDINOVA_VACUUM_COUNT		6
+#define MAX_SCANDINOVA_PAGE_COUNT		4	// ping 0 ~ 3
+#define SDN_MAX_TOKEN					20	// fields of a ping reply
+#define SDN_MAX_TOKEN_LEN				64	// longest field + 1
 
 #define MASTER							1
 #define SLAVE							0
 
+// auto drive state (pending hold after which the algorithm continues)
+#define AD_STATE_RUN					0
+#define AD_STATE_STARTUP				1
+#define AD_STATE_RESET_BLOCK			2	// trip blocking before h/w interlock reset
+#define AD_STATE_RESET_WAIT				3	// after h/w interlock reset
+#define AD_STATE_RESET_HV				4	// hv set to 300v, before hv on
+#define AD_STATE_ALARM_DECREASE			5
+#define AD_STATE_ALARM_BLOCK			6
+#define AD_STATE_MIDPOINT_BLOCK			7
+
+// autoDriveFastCheck results
+#define AD_FAST_NONE					0
+#define AD_FAST_TRIP					1	// new trip high crossing, go to standby now
+#define AD_FAST_ALARM					2	// new alarm high crossing
+
+#define AD_RAMP_FIXED					0	// +10v / +dbHVRampSpeed per step
+#define AD_RAMP_ADAPTIVE				1	// step size from headroom and arc rate
+
+#include <stddef.h>
 #include <epicsTime.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct
 {
-	epicsTimeStamp tLastIncrease;
+	double dbLastIncrease;			// auto drive clock (unit: sec)
+	double dbHoldUntil;				// auto drive clock (unit: sec)
+	int nState;
 	int nPriority;
 	int nParentId;
 	int bUse;
@@ -37,8 +65,244 @@ typedef struct
 
 	double dbHVRampSpeed;			// rising time(dbHVRampSpeed / dbHVRampCheckTime) (v/sec)
 	double dbHVRampCheckTime;		
+
+	// settle detection (next hv step as soon as the last one settled)
+	int bSettleUse;
+	int bSettled;
+	double dbSettleTolerance;		// hvps readback - setpoint (unit: v)
+	double dbSettleWindow;			// stable time before settled (unit: sec)
+	double dbSettleVacuumBand;		// max vacuum change within the window
+	double dbSettleStart;			// auto drive clock, < 0: not tracking
+	double dbSettleVacuumRef;
+	double dbSettleArcRef;
+	double dbCommandedHv;			// last setpoint sent by auto drive, < 0: none
+
+	// adaptive ramp (step size from vacuum headroom and arc rate)
+	int nRampMode;					// AD_RAMP_FIXED, AD_RAMP_ADAPTIVE
+	double dbAdaptSpeedMin;			// hv step at no headroom (unit: v)
+	double dbAdaptSpeedMax;			// hv step at full headroom (unit: v)
+	double dbAdaptHeadroomGain;
+	double dbAdaptArcGain;			// (unit: 1/(arc/sec))
+	double dbAdaptArcTau;			// arc rate filter time constant (unit: sec)
+	double dbAdaptSpeed;			// current hv step (unit: v)
+	double dbArcRateFilt;			// filtered ct+cvd arc rate (unit: arc/sec)
+	double dbAdaptLastSample;		// auto drive clock, < 0: no sample yet
+
+	// stale data (ping 0 and 1 older than dbStaleLimit): no hv change
+	double dbStaleLimit;			// (unit: sec)
+	int bStaleStandby;				// also go to standby when data gets stale
+	int bStale;
+
+	// fast path soft interlock: trip latched from the hv of the crossing (autoDriveFastTrip)
+	int bFastTrip;
+
+	double dbCommandTime;			// auto drive clock of the last hv command
 } SCANDINOVA_AUTO_DRIVE_INFO;
 
+// a double or int field by name (autoDriveParams, the model of scandinovaSim)
+typedef struct
+{
+	const char *name;
+	size_t offset;
+	int bInt;						// int field instead of double
+} SCANDINOVA_PARAM_DEF;
+
+// values of one decoded ping the settle detection and the adaptive ramp use
+typedef struct
+{
+	double dbTime;					// auto drive clock of the ping (unit: sec)
+	double dbHvSet;					// (unit: v)
+	double dbHvRead;
+	double dbArc;					// ct + cvd arcs per second
+	double dbVacuum;
+} SCANDINOVA_AD_SAMPLE;
+
+// fast path crossing latch of one channel, owned by the port thread
+typedef struct
+{
+	int bTrip;						// vacuum above trip high limit
+	int bAlarm;						// vacuum above alarm high limit
+} SCANDINOVA_FAST_LATCH;
+
+typedef struct
+{
+	int bUse;
+	int bActive;					// trajectory not yet at target
+	double dbTarget;				// (unit: v)
+	double dbSlewRate;				// (unit: v/sec)
+	double dbUpdateRate;			// setpoint writes per second (unit: Hz)
+	double dbPoint;					// current trajectory point (unit: v)
+	int nCoalesced;					// points merged while the port was busy
+	int nDropped;					// writes not started within SLEW_WRITE_TIMEOUT
+} SCANDINOVA_HV_SLEW_INFO;
+
+// recipe state
+#define RCP_STATE_IDLE					0
+#define RCP_STATE_RUN					1
+#define RCP_STATE_PAUSE					2
+#define RCP_STATE_DONE					3
+
+// recipe commands (AO_RECIPE_CMD)
+#define RCP_CMD_STOP					0	// back to step 1, idle
+#define RCP_CMD_RUN						1	// start or resume
+#define RCP_CMD_PAUSE					2
+
+// recipeEvaluate results
+#define RCP_EVENT_NONE					0
+#define RCP_EVENT_BACKOFF				1	// previous step again
+#define RCP_EVENT_ADVANCE				2	// next step
+#define RCP_EVENT_DONE					3	// last step completed
+
+typedef struct
+{
+	double dbHv;					// target (unit: v)
+	double dbPrf;					// < 0: unchanged (unit: Hz)
+	double dbPlswth;				// < 0: unchanged (unit: us)
+	double dbDwell;					// time within the advance gate at target (unit: sec)
+	double dbVacAdvance;			// dwell counts below these
+	double dbArcAdvance;
+	double dbVacBackoff;			// back to the previous step at or above these
+	double dbArcBackoff;
+} SCANDINOVA_RECIPE_STEP;
+
+// runtime trace mask (var scandinovaTraceMask), prints through epicsPrintf
+#define SDN_TRACE_PING0					0x0001	// raw frames and tokens of ping 0 ~ 3
+#define SDN_TRACE_PING1					0x0002
+#define SDN_TRACE_PING2					0x0004
+#define SDN_TRACE_PING3					0x0008
+#define SDN_TRACE_ERROR					0x0010	// frames rejected by the parser
+#define SDN_TRACE_SLOW					0x0020	// ping interval above SDN_SLOW_PING_INTERVAL
+#define SDN_TRACE_COMMAND				0x0040	// commands written with dbpf
+#define SDN_TRACE_AUTODRIVE				0x0080	// auto drive state and hv step changes
+
+// command write verification (writeVerify.c), written command -> read back of the next ping
+#define SDN_VERIFY_STATE				0	// {W|001|%04X} -> dbStateSet (ping 0)
+#define SDN_VERIFY_HV					1	// {W|3EB|%.4f} -> dbHVPSVoltSet (ping 0)
+#define SDN_VERIFY_CONTROL				2	// {W|003|%04X} -> dbControlWordSet (ping 2), reset bits ignored
+#define SDN_VERIFY_COUNT				3
+
+#define SDN_VERIFY_IDLE					0	// nothing written yet
+#define SDN_VERIFY_PENDING				1	// written, not yet in a ping frame
+#define SDN_VERIFY_APPLIED				2
+#define SDN_VERIFY_FAILED				3	// not applied after the last retry
+
+#define SDN_VERIFY_HV_TOLERANCE			0.5	// (unit: v)
+
+#define SDN_POLL_PERIOD					1.0		// default period of the poll scheduler (unit: sec)
+#define SDN_SLOW_PING_INTERVAL			2.0		// (unit: sec)
+
+// per ping page statistics for scandinovaReport
+typedef struct
+{
+	int nFrames;
+	int nParseErrors;
+	double dbInterval;				// last frame to frame (unit: sec)
+	double dbIntervalMin;
+	double dbIntervalMax;
+	double dbIntervalSum;			// mean over nFrames-1 intervals
+	double dbLatency;				// previous page -> this page of the same poll (unit: sec)
+	double dbLatencyMax;
+} SCANDINOVA_PAGE_DIAG;
+
+#define SDN_STATE_MODE_MASK				0xF000	// mode nibble of the state word
+#define SDN_STATE_MODE_FAULT			0xF000
+#define SDN_FAULT_MASK_DEFAULT			0x0FFF	// interlock bits, the mode nibble changes in normal operation
+
+// first fault latch on the state word (pingParse.c)
+typedef struct
+{
+	int nMask;						// state word bits that count as interlocks
+	int bValid;						// nLastWord holds a word
+	int nLastWord;
+	int bLatched;					// until scandinovaFaultReset
+	int nFirstBit;					// lowest bit of nChangedMask, -1: none
+	int nChangedMask;				// masked bits set and mode bits of a fault entry in that frame
+	int nWordBefore;
+	int nWordAfter;
+	double dbTime;					// receive time of that frame (unit: sec)
+} SCANDINOVA_FAULT_INFO;
+
+// write verification of one command (writeVerify.c), updated in the port thread
+typedef struct
+{
+	int nStatus;					// SDN_VERIFY_xxx
+	double dbValue;					// last value written
+	double dbFirstSent;				// first write of dbValue (unit: sec)
+	double dbLastSent;				// first write or last retry (unit: sec)
+	int nTries;						// retries of dbValue
+	double dbLatency;				// first write -> receive of the frame showing it (unit: sec)
+	double dbLatencyMax;
+	int nApplied;
+	int nRetries;
+	int nFailed;
+} SCANDINOVA_VERIFY_INFO;
+
+// ramp scheduler of a station group (rampGroup.c)
+typedef struct
+{
+	int nGroup;						// 0: none, else group number (1 ~)
+	int nRank;						// best headroom rank of its channels last schedule, 0: no request
+	int nGrants;
+	int nDefers;
+	double dbGroupPower;			// sum of dbPowRead of the members
+	double dbPowerBudget;
+	double dbDvLeft;				// hv step budget left (unit: v)
+	double dbDvBudget;				// (unit: v/min)
+} SCANDINOVA_SCHED_INFO;
+
+// hv step request of one auto drive channel of a group member (rampGroupRank.c)
+typedef struct
+{
+	int nDevIdx;
+	int nIdx;
+	int nOrder;						// ranking order of equal headroom
+	int bPending;
+	int bGranted;
+	double dbFrom;					// (unit: v)
+	double dbTo;
+	double dbGrantTime;				// (unit: sec)
+	double dbHeadroom;				// vacuum headroom, 1: far from the alarm, 0: at the alarm
+	double dbPowRead;				// power of the modulator when ranked
+	int nRank;						// 1 ~ of the last schedule
+	int bOversize;					// step larger than the whole hv budget
+	int bOversizeLogged;
+} SCANDINOVA_RAMP_REQUEST;
+
+typedef struct
+{
+	SCANDINOVA_RECIPE_STEP *pSteps;
+	int nStepCount;
+	int nState;						// RCP_STATE_xxx
+	int nStep;						// current step, 0 based
+	int bApplied;					// setpoints of nStep written
+	double dbDwellDone;				// (unit: sec)
+	double dbProgress;				// completed dwell of the whole recipe (unit: %)
+	double dbEta;					// remaining dwell, ramps not included (unit: sec)
+	int nBackoffs;
+	int bBackedOff;					// until vacuum and arc are below the advance gate
+	int bMaxPointSaved;
+	double dbSavedMaxPoint;			// master dbHVMaxPoint before the run
+} SCANDINOVA_RECIPE_INFO;
+
+// poll scheduler (scandinovaPoll.c), SCAN1FAN of a modulator on its own phase
+typedef struct
+{
+	int bUse;						// POLL_TICK record loaded
+	double dbPeriod;				// (unit: sec)
+	double dbPhase;					// slot offset within the period, < 0: spread evenly (unit: sec)
+	double dbPhaseUsed;
+	double dbNext;					// next slot (unit: sec)
+	double dbFired;					// last slot issued, 0: none
+	int bAnswered;					// ping 0 of the last slot decoded
+	int bDone;						// ping 3 of the last slot decoded
+	int nPolls;
+	int nOverruns;					// slot due while the answered previous poll was not done
+	int nNoReply;					// slot due while the previous poll got no answer
+	int nMissed;					// slots skipped, the scheduler woke a period late
+	double dbLatency;				// slot -> ping 3 decoded (unit: sec)
+	double dbLatencyMax;
+} SCANDINOVA_POLL_INFO;
+
 typedef struct 
 {
 	int nDevIdx;
@@ -85,6 +349,41 @@ typedef struct
 	// ping 3
 	
 
+	// startup
+	int bPresent;					// asyn port "L<dev>" exists at init
+	int bReady;						// ping 0 and 1 decoded at least once
+	double dbStartupTime;			// device support init -> startup ping done (unit: sec)
+
+	// data age
+	double dbPageTime[MAX_SCANDINOVA_PAGE_COUNT];	// auto drive clock of the last decoded ping, 0: none
+	epicsTimeStamp tPageRecv[MAX_SCANDINOVA_PAGE_COUNT];	// receive time of that frame, TSE=-2 of its records
+	double dbStaleLimit;			// older pages raise INVALID severity (unit: sec)
+	SCANDINOVA_PAGE_DIAG PGD[MAX_SCANDINOVA_PAGE_COUNT];
+
+	// poll scheduler
+	SCANDINOVA_POLL_INFO POL;
+
+	// first fault latch
+	SCANDINOVA_FAULT_INFO FFL;
+
+	// write verification of state, hv and control word commands
+	SCANDINOVA_VERIFY_INFO VFY[SDN_VERIFY_COUNT];
+	double dbVerifyTimeout;			// written -> retry when not applied (unit: sec)
+	int nVerifyRetries;
+
+	// fast path soft interlock
+	double dbTripLatency;			// ping 1 receive -> standby written (unit: sec)
+	int nFastTrips;
+
+	// hv slew generator
+	SCANDINOVA_HV_SLEW_INFO HVS;
+
+	// conditioning recipe
+	SCANDINOVA_RECIPE_INFO RCP;
+
+	// station group ramp scheduler
+	SCANDINOVA_SCHED_INFO SCH;
+
 	// auto drive
 	SCANDINOVA_AUTO_DRIVE_INFO SADI[MAX_SCANDINOVA_VACUUM_COUNT];
 	//double dbHVPSVoltRead;
@@ -94,8 +393,143 @@ typedef struct
 
 } SCANDINOVA_INFO;
 
+// clock/actuator interface of the auto drive algorithm (live ioc or simulation)
+typedef struct
+{
+	double (*getTime)(void *pPvt);		// (unit: sec)
+	SCANDINOVA_INFO *(*getInfo)(void *pPvt, int nDevIdx);
+	int (*changeMode)(void *pPvt, int nDevIdx, int nMode);
+	int (*setHv)(void *pPvt, int nDevIdx, double dbSetpoint);
+	int (*hwControlSet)(void *pPvt, int nDevIdx, int nMode);
+	int (*grantStep)(void *pPvt, int nDevIdx, int nIdx, double dbFrom, double dbTo);	// NULL: always, 0: not now
+	void *pPvt;
+} SCANDINOVA_AUTO_DRIVE_OPS;
+
+// shadow auto drive (autoDriveShadow.c): the decisions of one channel with
+// another parameter set on the same live samples, commands only recorded
+#define MAX_SCANDINOVA_SHADOW_COUNT		4	// per modulator
+#define SDN_SHADOW_MAX_PARAMS			16	// overrides of the source parameters
+#define SDN_SHADOW_AT_MAX				2.0	// within this of dbHVMaxPoint counts as reached (unit: v)
+
+typedef struct
+{
+	int bUse;
+	int nSource;					// auto drive channel followed, SADI index
+	int nParams;
+	int nParam[SDN_SHADOW_MAX_PARAMS];	// shadow parameter table index
+	double dbParam[SDN_SHADOW_MAX_PARAMS];
+
+	int bStarted;					// 0: fork from the source on the next process
+	SCANDINOVA_AUTO_DRIVE_INFO sadi;
+	SCANDINOVA_INFO view;			// live sample with the shadow hv and state word
+	SCANDINOVA_VERIFY_INFO hvVfy;	// shadow writes apply at once
+	double dbNow;					// clock of the running process call (unit: sec)
+	double dbLastProcess;
+	double dbHvSet;					// shadow hv trajectory (unit: v)
+	int nMode;						// shadow state word
+	int nLiveState;
+
+	// what the shadow would have done since the fork
+	double dbStart;
+	double dbHvStart;
+	double dbLiveHvStart;
+	int nSteps;
+	int nTrips;
+	int nAlarms;
+	double dbHoldTime;				// not in AD_STATE_RUN (unit: sec)
+	double dbTimeToMax;				// from the mean ramp rate, 0: reached, -1: not rising (unit: sec)
+	double dbLiveTimeToMax;			// same for the source channel
+} SCANDINOVA_SHADOW_INFO;
+
 extern SCANDINOVA_INFO SDN[MAX_SCANDINOVA_CNT];
 
+// autoDrive.c
+void autoDriveSetDefaults(SCANDINOVA_AUTO_DRIVE_INFO *p, int nDevIdx, int nIdx);
+extern const SCANDINOVA_PARAM_DEF autoDriveParams[];
+int autoDriveFindParam(const SCANDINOVA_PARAM_DEF *pTable, const char *name, size_t nLen);
+void autoDriveSetParam(const SCANDINOVA_PARAM_DEF *pParam, void *pBase, double dbVal);
+void autoDriveStart(SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_AUTO_DRIVE_OPS *pOps);
+void autoDriveProcess(SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_AUTO_DRIVE_OPS *pOps);
+int autoDriveFastCheck(const SCANDINOVA_AUTO_DRIVE_INFO *p, SCANDINOVA_FAST_LATCH *pLatch);
+void autoDriveFastTrip(SCANDINOVA_AUTO_DRIVE_INFO *p, double dbHvRead);
+void autoDriveTakeSample(const SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_INFO *pInfo, double dbNow,
+		SCANDINOVA_AD_SAMPLE *pSmp);
+void autoDriveSample(SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_AD_SAMPLE *pSmp);
+int increaseHv(SCANDINOVA_AUTO_DRIVE_INFO *p, const SCANDINOVA_AUTO_DRIVE_OPS *pOps);
+
 extern SCANDINOVA_AUTO_DRIVE_INFO SADI[MAX_SCANDINOVA_VACUUM_COUNT];
 
+// autoDriveShadow.c
+int autoDriveShadowConfigure(SCANDINOVA_SHADOW_INFO *pShd, int nSource, const char *strParams);
+void autoDriveShadowProcess(SCANDINOVA_SHADOW_INFO *pShd, const SCANDINOVA_AUTO_DRIVE_INFO *pSrc,
+		const SCANDINOVA_INFO *pLive, double dbNow);
+
+// scandinovaShm.c
+int scandinovaShmConfigure(const char *name);
+void scandinovaShmPublish(int nDevIdx, int nPage, const epicsTimeStamp *ptRecv);
+
+// hvSlew.c
+int hvSlewInit(int nDevIdx);
+int hvSlewSetTarget(int nDevIdx, double dbTarget);
+
+// recipe.c
+int scandinovaRecipeConfigure(int nDevIdx, const char *recipeFile, const char *stateFile);
+int recipeInit(int nDevIdx);
+int recipeCommand(int nDevIdx, int nCmd);
+
+// pingParse.c
+int scandinovaSplitPing(const char *recvBuf, size_t nRet, const char *strPrefix, char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN]);
+int scandinovaPageMinTokens(int nPage);
+int scandinovaStorePing(SCANDINOVA_INFO *pInfo, int nPage, char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN], int nCnt);
+int scandinovaParsePing(SCANDINOVA_INFO *pInfo, int nPage, const char *recvBuf, size_t nRet);
+void scandinovaFaultSample(SCANDINOVA_FAULT_INFO *pFault, int nWord, double dbTime);
+void scandinovaFaultReset(SCANDINOVA_FAULT_INFO *pFault);
+
+// writeVerify.c
+void scandinovaVerifyStart(SCANDINOVA_VERIFY_INFO *pVfy, double dbValue, double dbNow);
+int scandinovaVerifyFrame(SCANDINOVA_INFO *pInfo, int nPage, double dbFrameTime);
+void scandinovaVerifyRetry(SCANDINOVA_VERIFY_INFO *pVfy, double dbNow);
+void scandinovaVerifyReset(SCANDINOVA_VERIFY_INFO *pVfy);
+
+// recipeEngine.c
+int recipeEvaluate(SCANDINOVA_RECIPE_INFO *pRcp, double dbVacuum, double dbArc, double dbHvRead, double dbDt);
+
+// scandinovaPoll.c
+int scandinovaPollConfigure(int nDevIdx, double dbPeriod, double dbPhase);
+double scandinovaPollPeriod(int nDevIdx);
+void scandinovaPollDecoded(int nDevIdx, int nPage, double dbTime);
+
+// pollSlot.c
+void scandinovaPollPlace(SCANDINOVA_POLL_INFO *pList[], int nCount, double dbStart, double dbNow);
+void scandinovaPollFire(SCANDINOVA_POLL_INFO *pPoll, double dbNow);
+void scandinovaPollAnswer(SCANDINOVA_POLL_INFO *pPoll, int nPage, double dbTime);
+
+// devSCANDINOVAWord.c
+void scandinovaWordUpdate(int nDevIdx);
+
+// rampGroup.c
+int scandinovaGroupConfigure(const char *name, const char *members, double dbPowerBudget, double dbDvBudget);
+int rampGroupInit(void);
+int rampGroupGrant(int nDevIdx, int nIdx, double dbFrom, double dbTo);
+int rampGroupSetBudget(int nDevIdx, double dbPowerBudget, double dbDvBudget);
+
+// rampGroupRank.c
+double rampGroupPredictPower(const SCANDINOVA_RAMP_REQUEST *pReq);
+int rampGroupRank(SCANDINOVA_RAMP_REQUEST *pList[], int nReq, SCANDINOVA_SCHED_INFO *pSch, double dbNow);
+
+// devSCANDINOVA.c
+extern int scandinovaTraceMask;
+int scandinovaReport(int nLevel);
+int changeMode(int nDevIdx, int nMode);
+int setHv(int nDevIdx, double dbSetpoint);
+int hwControlSet(int nDevIdx, int nMode);
+int prfSet(int nDevIdx, int nPrf);
+int plswthSet(int nDevIdx, double dbPlswth);
+void scandinovaSetMaxPoint(int nDevIdx, int nIdx, double dbMaxPoint);
+double scandinovaMaxPoint(int nDevIdx, int nIdx);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
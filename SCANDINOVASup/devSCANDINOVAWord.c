@@ -0,0 +1,241 @@
+/*
+ * SCANDINOVA state/control word device support (DTYP "SCANDINOVA Word")
+ *
+ * The devGpib table of devSCANDINOVA.c has no I/O Intr for soft values, so
+ * the decoded words of a modulator are published here: every decoded ping 0
+ * (state word, first fault latch) and ping 2 (control word) requests an I/O
+ * Intr scan of the records of that modulator.
+ *
+ *   field(INP, "@<dev> <item> [bit]")
+ *
+ *   STATE, CONTROL          mbbiDirect (whole word) or bi (with bit)
+ *   FAULT_LATCHED           bi, first fault latched
+ *   FAULT_BIT               longin, first changed bit, -1: none
+ *   FAULT_MASK              mbbiDirect, bits changed in the first fault frame
+ *   FAULT_BEFORE, FAULT_AFTER  mbbiDirect, state word around the first fault
+ *
+ * With TSE=-2 a record carries the receive time of the frame the value came
+ * from, the FAULT_xxx records the time of the first fault frame.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alarm.h>
+#include <dbDefs.h>
+#include <dbAccess.h>
+#include <dbScan.h>
+#include <recGbl.h>
+#include <devSup.h>
+#include <link.h>
+#include <epicsTime.h>
+#include <epicsExport.h>
+#include <biRecord.h>
+#include <longinRecord.h>
+#include <mbbiDirectRecord.h>
+
+#include "devSCANDINOVA.h"
+
+#define WORD_STATE				0
+#define WORD_CONTROL			1
+#define WORD_FAULT_LATCHED		2
+#define WORD_FAULT_BIT			3
+#define WORD_FAULT_MASK			4
+#define WORD_FAULT_BEFORE		5
+#define WORD_FAULT_AFTER		6
+
+static const char *wordItems[] = {
+	"STATE", "CONTROL", "FAULT_LATCHED", "FAULT_BIT", "FAULT_MASK", "FAULT_BEFORE", "FAULT_AFTER", NULL
+};
+
+typedef struct
+{
+	int nDevIdx;
+	int nItem;
+	int nBit;					// -1: whole word
+} WORD_PVT;
+
+static IOSCANPVT wordScan[MAX_SCANDINOVA_CNT];
+
+// from pageDecoded, port thread
+void scandinovaWordUpdate(int nDevIdx)
+{
+	if(wordScan[nDevIdx])
+		scanIoRequest(wordScan[nDevIdx]);
+}
+
+static long initWord(int pass)
+{
+	int nDevIdx;
+
+	if(pass == 0)
+	{
+		for(nDevIdx=0;nDevIdx!=MAX_SCANDINOVA_CNT;++nDevIdx)
+			scanIoInit(&wordScan[nDevIdx]);
+	}
+	return 0;
+}
+
+static long initWordRecord(dbCommon *prec, struct link *pLink)
+{
+	WORD_PVT *pPvt;
+	char strItem[32];
+	int nDevIdx;
+	int nBit = -1;
+	int i;
+
+	if(pLink->type != INST_IO
+			|| sscanf(pLink->value.instio.string,"%d %31s %d",&nDevIdx,strItem,&nBit) < 2
+			|| nDevIdx < 0 || nDevIdx >= MAX_SCANDINOVA_CNT || nBit < -1 || nBit > 15)
+	{
+		recGblRecordError(S_db_badField,(void *)prec,"devSCANDINOVAWord: INP must be \"@<dev> <item> [bit]\"");
+		return S_db_badField;
+	}
+	for(i=0;wordItems[i];++i)
+	{
+		if(strcmp(strItem,wordItems[i]) == 0)
+			break;
+	}
+	if(wordItems[i] == NULL)
+	{
+		recGblRecordError(S_db_badField,(void *)prec,"devSCANDINOVAWord: unknown item");
+		return S_db_badField;
+	}
+
+	pPvt = (WORD_PVT *)calloc(1,sizeof(WORD_PVT));
+	pPvt->nDevIdx = nDevIdx;
+	pPvt->nItem = i;
+	pPvt->nBit = nBit;
+	prec->dpvt = pPvt;
+	return 0;
+}
+
+static long getWordIoIntInfo(int cmd, dbCommon *prec, IOSCANPVT *ppvt)
+{
+	WORD_PVT *pPvt = (WORD_PVT *)prec->dpvt;
+
+	if(pPvt == NULL)
+		return -1;
+	*ppvt = wordScan[pPvt->nDevIdx];
+	return 0;
+}
+
+// value of a record, also its timestamp with TSE=-2
+static int readWord(dbCommon *prec, int *pnValue)
+{
+	WORD_PVT *pPvt = (WORD_PVT *)prec->dpvt;
+	SCANDINOVA_INFO *pInfo;
+	double dbTime;
+	int nValue;
+	int nPage = -1;
+
+	if(pPvt == NULL)
+		return -1;
+	pInfo = &SDN[pPvt->nDevIdx];
+
+	switch(pPvt->nItem)
+	{
+		case WORD_STATE:			nValue = (int)pInfo->dbStateRead; dbTime = pInfo->dbPageTime[0]; nPage = 0; break;
+		case WORD_CONTROL:			nValue = (int)pInfo->dbControlWordSet; dbTime = pInfo->dbPageTime[2]; nPage = 2; break;
+		case WORD_FAULT_LATCHED:	nValue = pInfo->FFL.bLatched; dbTime = pInfo->FFL.dbTime; break;
+		case WORD_FAULT_BIT:		nValue = pInfo->FFL.nFirstBit; dbTime = pInfo->FFL.dbTime; break;
+		case WORD_FAULT_MASK:		nValue = pInfo->FFL.nChangedMask; dbTime = pInfo->FFL.dbTime; break;
+		case WORD_FAULT_BEFORE:		nValue = pInfo->FFL.nWordBefore; dbTime = pInfo->FFL.dbTime; break;
+		default:					nValue = pInfo->FFL.nWordAfter; dbTime = pInfo->FFL.dbTime; break;
+	}
+	if(pPvt->nBit >= 0)
+		nValue = (nValue >> pPvt->nBit) & 1;
+	*pnValue = nValue;
+
+	if(prec->tse == epicsTimeEventDeviceTime)
+	{
+		if(nPage >= 0 && dbTime > 0)
+			prec->time = pInfo->tPageRecv[nPage];
+		else if(dbTime > 0)
+		{
+			prec->time.secPastEpoch = (epicsUInt32)dbTime;
+			prec->time.nsec = (epicsUInt32)((dbTime - prec->time.secPastEpoch) * 1e9);
+		}
+		else
+			epicsTimeGetCurrent(&prec->time);
+	}
+
+	// no frame yet
+	if(pPvt->nItem <= WORD_CONTROL && dbTime <= 0)
+	{
+		recGblSetSevr(prec,READ_ALARM,INVALID_ALARM);
+		return -1;
+	}
+	return 0;
+}
+
+static long initBiRecord(struct biRecord *prec)
+{
+	return initWordRecord((dbCommon *)prec,&prec->inp);
+}
+static long readBi(struct biRecord *prec)
+{
+	int nValue;
+
+	if(readWord((dbCommon *)prec,&nValue) != 0)
+		return 2;
+	prec->val = nValue ? 1 : 0;
+	prec->udf = FALSE;
+	return 2;
+}
+
+static long initLonginRecord(struct longinRecord *prec)
+{
+	return initWordRecord((dbCommon *)prec,&prec->inp);
+}
+static long readLongin(struct longinRecord *prec)
+{
+	int nValue;
+
+	if(readWord((dbCommon *)prec,&nValue) != 0)
+		return 0;
+	prec->val = nValue;
+	prec->udf = FALSE;
+	return 0;
+}
+
+static long initMbbidRecord(struct mbbiDirectRecord *prec)
+{
+	return initWordRecord((dbCommon *)prec,&prec->inp);
+}
+static long readMbbid(struct mbbiDirectRecord *prec)
+{
+	int nValue;
+
+	if(readWord((dbCommon *)prec,&nValue) != 0)
+		return 2;
+	prec->val = (unsigned short)nValue;
+	prec->udf = FALSE;
+	return 2;
+}
+
+typedef struct
+{
+	long number;
+	DEVSUPFUN report;
+	DEVSUPFUN init;
+	DEVSUPFUN init_record;
+	DEVSUPFUN get_ioint_info;
+	DEVSUPFUN read;
+} WORD_DSET;
+
+WORD_DSET devBiSCANDINOVAWord = {
+	5, NULL, (DEVSUPFUN)initWord, (DEVSUPFUN)initBiRecord, (DEVSUPFUN)getWordIoIntInfo, (DEVSUPFUN)readBi
+};
+epicsExportAddress(dset, devBiSCANDINOVAWord);
+
+WORD_DSET devLiSCANDINOVAWord = {
+	5, NULL, NULL, (DEVSUPFUN)initLonginRecord, (DEVSUPFUN)getWordIoIntInfo, (DEVSUPFUN)readLongin
+};
+epicsExportAddress(dset, devLiSCANDINOVAWord);
+
+WORD_DSET devMbbidSCANDINOVAWord = {
+	5, NULL, NULL, (DEVSUPFUN)initMbbidRecord, (DEVSUPFUN)getWordIoIntInfo, (DEVSUPFUN)readMbbid
+};
+epicsExportAddress(dset, devMbbidSCANDINOVAWord);
@@ -0,0 +1,443 @@
+/*
+ * SCANDINOVA modulator asynPortDriver (see drvSCANDINOVA.h)
+ *
+ * The poller sends {P|000}..{P|003} on the octet port, splits the reply at
+ * '|' and stores every field in its parameter; the receive time of a ping is
+ * the timestamp of all parameters it updated (records with TSE=-2). Replies
+ * are split by pingParse.c, a frame the device support rejects is rejected
+ * here as well.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <epicsStdio.h>
+#include <errlog.h>
+#include <epicsThread.h>
+#include <epicsString.h>
+#include <asynOctetSyncIO.h>
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include "drvSCANDINOVA.h"
+#include "devSCANDINOVA.h"
+#include "scandinovaThread.h"
+
+#define SDN_IO_TIMEOUT				1.0
+#define SDN_REPLY_LEN				300
+
+typedef struct
+{
+	const char *name;
+	int nPing;
+	int nToken;					// index after splitting "{p|00n|..." at '|'
+	int bHex;
+	int nWord;					// also published as status word (SDN_WORD_xxx)
+} SDN_FIELD;
+
+#define SDN_WORD_NONE				0
+#define SDN_WORD_STATE				1
+#define SDN_WORD_CONTROL			2
+
+// same token layout as procPing0Msg ~ procPing2Msg of devSCANDINOVA.c
+static const SDN_FIELD fieldTable[] = {
+	// ping 0
+	{"STATE_SET",				0,	3,	1,	SDN_WORD_NONE},
+	{"STATE_READ",				0,	2,	1,	SDN_WORD_STATE},
+	{"FILAMENT_VOLT",			0,	4,	0,	SDN_WORD_NONE},
+	{"FILAMENT_CURR",			0,	5,	0,	SDN_WORD_NONE},
+	{"CT",						0,	6,	0,	SDN_WORD_NONE},
+	{"CVD",						0,	7,	0,	SDN_WORD_NONE},
+	{"CT_ARC_PER_SEC",			0,	8,	1,	SDN_WORD_NONE},
+	{"CVD_ARC_PER_SEC",			0,	9,	1,	SDN_WORD_NONE},
+	{"PRF",						0,	10,	0,	SDN_WORD_NONE},
+	{"PLSWTH",					0,	11,	0,	SDN_WORD_NONE},
+	{"POW",						0,	12,	0,	SDN_WORD_NONE},
+	{"HVPS_VOLT",				0,	13,	0,	SDN_WORD_NONE},
+	{"HVPS_VOLT_SET",			0,	14,	0,	SDN_WORD_NONE},
+	{"PLSWTH_SET",				0,	15,	0,	SDN_WORD_NONE},
+	{"PRF_SET",					0,	16,	0,	SDN_WORD_NONE},
+	{"REMAINING_TIME",			0,	17,	1,	SDN_WORD_NONE},
+	{"ACCESS_LEVEL",			0,	18,	1,	SDN_WORD_NONE},
+	// ping 1
+	{"MAG_PS1_VOLT",			1,	2,	0,	SDN_WORD_NONE},
+	{"MAG_PS1_CURR",			1,	3,	0,	SDN_WORD_NONE},
+	{"MAG_PS1_CURR_SET",		1,	4,	0,	SDN_WORD_NONE},
+	{"MAG_PS2_VOLT",			1,	5,	0,	SDN_WORD_NONE},
+	{"MAG_PS2_CURR",			1,	6,	0,	SDN_WORD_NONE},
+	{"MAG_PS3_VOLT",			1,	7,	0,	SDN_WORD_NONE},
+	{"MAG_PS3_CURR",			1,	8,	0,	SDN_WORD_NONE},
+	{"MAG_PS4_VOLT",			1,	9,	0,	SDN_WORD_NONE},
+	{"PRES1",					1,	10,	0,	SDN_WORD_NONE},
+	// ping 2
+	{"STANDBY_CURR_SET",		2,	2,	0,	SDN_WORD_NONE},
+	{"CONTROL_WORD_SET",		2,	3,	1,	SDN_WORD_CONTROL},
+	{"MAG_PS2_CURR_HIGH_LIMIT",	2,	4,	0,	SDN_WORD_NONE},
+	{"MAG_PS2_CURR_LOW_LIMIT",	2,	5,	0,	SDN_WORD_NONE},
+	{"MAG_PS2_CURR_SET",		2,	6,	0,	SDN_WORD_NONE},
+	{"MAG_PS3_CURR_SET",		2,	7,	0,	SDN_WORD_NONE},
+	{"MAG_PS4_CURR_SET",		2,	8,	0,	SDN_WORD_NONE},
+};
+#define NUM_FIELDS	(int)(sizeof(fieldTable)/sizeof(fieldTable[0]))
+
+typedef struct
+{
+	const char *name;
+	const char *format;
+} SDN_COMMAND;
+
+// float setpoints, same formats as the GPIBWRITE entries of devSCANDINOVA.c
+static const SDN_COMMAND cmdTable[] = {
+	{"STANDBY_CURR_CMD",		"{W|2BE|%.4f}"},
+	{"HVPS_VOLT_CMD",			"{W|3EB|%.4f}"},
+	{"PLSWTH_CMD",				"{W|4B3|%.4f}"},
+	{"MAG_PS1_CURR_CMD",		"{W|642|%.4f}"},
+	{"MAG_PS2_CURR_CMD",		"{W|6A6|%.4f}"},
+	{"MAG_PS3_CURR_CMD",		"{W|70A|%.4f}"},
+	{"MAG_PS4_CURR_CMD",		"{W|76E|%.4f}"},
+};
+#define NUM_COMMANDS	(int)(sizeof(cmdTable)/sizeof(cmdTable[0]))
+
+// fields, commands, 2 words, 3 int commands, ping arrays, 6 poller
+#define NUM_PARAMS	(NUM_FIELDS + NUM_COMMANDS + 2 + 3 + SDN_PING_COUNT + 6)
+
+static void pollerThreadC(void *pPvt)
+{
+	((drvSCANDINOVA*)pPvt)->pollerThread();
+}
+
+drvSCANDINOVA::drvSCANDINOVA(const char *portName, const char *octetPortName, double dbPeriod)
+	: asynPortDriver(portName, 1, NUM_PARAMS,
+		asynInt32Mask | asynFloat64Mask | asynUInt32DigitalMask | asynFloat64ArrayMask | asynDrvUserMask,
+		asynInt32Mask | asynFloat64Mask | asynUInt32DigitalMask | asynFloat64ArrayMask,
+		ASYN_CANBLOCK, 1, 0, 0),
+	  pasynUserOctet(NULL), pasynUserCmd(NULL), dbPollPeriod(dbPeriod), nControlWord(0)
+{
+	char strName[64];
+	int i;
+	int nParam;
+
+	wakeEvent = epicsEventMustCreate(epicsEventEmpty);
+	memset(dbValues, 0x00, sizeof(dbValues));
+	memset(nValues, 0x00, sizeof(nValues));
+
+	for(i=0;i!=NUM_FIELDS;++i)
+	{
+		createParam(fieldTable[i].name, asynParamFloat64, &nParam);
+		if(i == 0)
+			P_FirstField = nParam;
+	}
+	createParam("STATE_WORD", asynParamUInt32Digital, &P_StateWord);
+	createParam("CONTROL_WORD", asynParamUInt32Digital, &P_ControlWord);
+
+	createParam("STATE_CMD", asynParamInt32, &P_StateCmd);
+	createParam("CONTROL_CMD", asynParamUInt32Digital, &P_ControlCmd);
+	createParam("PRF_CMD", asynParamInt32, &P_PrfCmd);
+	for(i=0;i!=NUM_COMMANDS;++i)
+	{
+		createParam(cmdTable[i].name, asynParamFloat64, &nParam);
+		if(i == 0)
+			P_FirstCmd = nParam;
+	}
+
+	for(i=0;i!=SDN_PING_COUNT;++i)
+	{
+		sprintf(strName, "PING%d_VALUES", i);
+		createParam(strName, asynParamFloat64Array, &P_PingValues[i]);
+	}
+
+	createParam("POLL_PERIOD", asynParamFloat64, &P_PollPeriod);
+	createParam("POLL_COUNT", asynParamInt32, &P_PollCount);
+	createParam("POLL_ERRORS", asynParamInt32, &P_PollErrors);
+	createParam("POLL_JITTER", asynParamFloat64, &P_PollJitter);
+	createParam("POLL_JITTER_MAX", asynParamFloat64, &P_PollJitterMax);
+	createParam("CONNECTED", asynParamInt32, &P_Connected);
+
+	setDoubleParam(P_PollPeriod, dbPeriod);
+	setIntegerParam(P_PollCount, 0);
+	setIntegerParam(P_PollErrors, 0);
+	setDoubleParam(P_PollJitter, 0);
+	setDoubleParam(P_PollJitterMax, 0);
+	setIntegerParam(P_Connected, 0);
+
+	// poller and commands run in different threads, one asynUser each
+	if(pasynOctetSyncIO->connect(octetPortName, 0, &pasynUserOctet, NULL) != asynSuccess
+			|| pasynOctetSyncIO->connect(octetPortName, 0, &pasynUserCmd, NULL) != asynSuccess)
+	{
+		epicsPrintf("drvSCANDINOVA[%s]: cannot connect to port %s\n", portName, octetPortName);
+		pasynUserOctet = NULL;
+		pasynUserCmd = NULL;
+		return;
+	}
+	pasynOctetSyncIO->setInputEos(pasynUserOctet, "}", 1);
+
+	sprintf(strName, "SDNPOLL_%s", portName);
+	scandinovaThreadCreate(SDN_THREAD_POLLER, strName, epicsThreadPriorityMedium, epicsThreadStackMedium,
+			(EPICSTHREADFUNC)pollerThreadC, this);
+}
+
+/*
+ * One ping: the octet I/O runs unlocked, the values are stored and the
+ * callbacks are done with the driver lock held.
+ */
+asynStatus drvSCANDINOVA::ping(int nPing)
+{
+	char strCmd[16];
+	char recvBuf[SDN_REPLY_LEN];
+	char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN];
+	size_t nOut, nIn;
+	int nEom;
+	int nCnt;
+	int i;
+	epicsTimeStamp tRecv;
+	asynStatus status;
+
+	sprintf(strCmd, "{P|%03d}", nPing);
+	status = pasynOctetSyncIO->writeRead(pasynUserOctet, strCmd, strlen(strCmd),
+			recvBuf, sizeof(recvBuf) - 1, SDN_IO_TIMEOUT, &nOut, &nIn, &nEom);
+	epicsTimeGetCurrent(&tRecv);
+	if(status != asynSuccess)
+		return status;
+	recvBuf[nIn] = '\0';
+
+	sprintf(strCmd, "{p|%03d", nPing);
+	nCnt = scandinovaSplitPing(recvBuf, nIn, strCmd, result);
+	if(nCnt == 0 || nCnt < scandinovaPageMinTokens(nPing))
+		return asynError;
+
+	lock();
+	nValues[nPing] = nCnt > 2 ? nCnt - 2 : 0;
+	for(i=2;i<nCnt;++i)
+		dbValues[nPing][i - 2] = atof(result[i]);
+
+	for(i=0;i!=NUM_FIELDS;++i)
+	{
+		const SDN_FIELD *pField = &fieldTable[i];
+		double dbVal;
+
+		if(pField->nPing != nPing || pField->nToken >= nCnt)
+			continue;
+		dbVal = pField->bHex ? strtoul(result[pField->nToken], NULL, 16) : atof(result[pField->nToken]);
+		dbValues[nPing][pField->nToken - 2] = dbVal;
+		setDoubleParam(P_FirstField + i, dbVal);
+		if(pField->nWord == SDN_WORD_STATE)
+			setUIntDigitalParam(P_StateWord, (epicsUInt32)dbVal, 0xFFFFFFFF);
+		else if(pField->nWord == SDN_WORD_CONTROL)
+		{
+			nControlWord = (int)dbVal;
+			setUIntDigitalParam(P_ControlWord, (epicsUInt32)dbVal, 0xFFFFFFFF);
+		}
+	}
+
+	setTimeStamp(&tRecv);
+	callParamCallbacks();
+	doCallbacksFloat64Array(dbValues[nPing], nValues[nPing], P_PingValues[nPing], 0);
+	unlock();
+	return asynSuccess;
+}
+
+void drvSCANDINOVA::pollerThread()
+{
+	int nCount = 0;
+	int nErrors = 0;
+	int nPing;
+	int bConnected;
+	int bTimeout = 0;
+	epicsTimeStamp tWait;
+	epicsTimeStamp tWake;
+	SCANDINOVA_JITTER_INFO jitter;
+
+	scandinovaJitterReset(&jitter);
+	while(1)
+	{
+		bConnected = 1;
+		for(nPing=0;nPing!=SDN_PING_COUNT;++nPing)
+		{
+			if(ping(nPing) != asynSuccess)
+			{
+				bConnected = 0;
+				++nErrors;
+			}
+		}
+
+		lock();
+		setIntegerParam(P_PollCount, ++nCount);
+		setIntegerParam(P_PollErrors, nErrors);
+		setIntegerParam(P_Connected, bConnected);
+		if(bTimeout)
+		{
+			setDoubleParam(P_PollJitter, jitter.dbLast * 1000.0);
+			setDoubleParam(P_PollJitterMax, jitter.dbMax * 1000.0);
+		}
+		callParamCallbacks();
+		unlock();
+
+		// woken early for a new period: no jitter sample
+		epicsTimeGetCurrent(&tWait);
+		bTimeout = epicsEventWaitWithTimeout(wakeEvent, dbPollPeriod) == epicsEventWaitTimeout;
+		epicsTimeGetCurrent(&tWake);
+		if(bTimeout)
+			scandinovaJitterSample(&jitter, dbPollPeriod, epicsTimeDiffInSeconds(&tWake, &tWait));
+		else
+			scandinovaJitterReset(&jitter);
+	}
+}
+
+asynStatus drvSCANDINOVA::sendCommand(const char *strCmd)
+{
+	size_t nOut;
+
+	if(pasynUserCmd == NULL)
+		return asynDisconnected;
+	return pasynOctetSyncIO->write(pasynUserCmd, strCmd, strlen(strCmd), SDN_IO_TIMEOUT, &nOut);
+}
+
+asynStatus drvSCANDINOVA::writeFloat64(asynUser *pasynUser, epicsFloat64 value)
+{
+	int function = pasynUser->reason;
+	char strCmd[32];
+	asynStatus status;
+
+	if(function == P_PollPeriod)
+	{
+		if(value <= 0)
+			return asynError;
+		dbPollPeriod = value;
+		setDoubleParam(P_PollPeriod, value);
+		callParamCallbacks();
+		epicsEventSignal(wakeEvent);
+		return asynSuccess;
+	}
+	if(function < P_FirstCmd || function >= P_FirstCmd + NUM_COMMANDS)
+		return asynPortDriver::writeFloat64(pasynUser, value);
+
+	epicsSnprintf(strCmd, sizeof(strCmd), cmdTable[function - P_FirstCmd].format, value);
+	status = sendCommand(strCmd);
+	if(status != asynSuccess)
+	{
+		epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize,
+				"%s: write %s failed", portName, strCmd);
+		return status;
+	}
+	setDoubleParam(function, value);
+	callParamCallbacks();
+	return asynSuccess;
+}
+
+asynStatus drvSCANDINOVA::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+	int function = pasynUser->reason;
+	char strCmd[32];
+	asynStatus status;
+
+	if(function == P_StateCmd)
+		epicsSnprintf(strCmd, sizeof(strCmd), "{W|001|%04X}", value);
+	else if(function == P_PrfCmd)
+		epicsSnprintf(strCmd, sizeof(strCmd), "{W|12C|%d}", value);
+	else
+		return asynPortDriver::writeInt32(pasynUser, value);
+
+	status = sendCommand(strCmd);
+	if(status != asynSuccess)
+	{
+		epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize,
+				"%s: write %s failed", portName, strCmd);
+		return status;
+	}
+	setIntegerParam(function, value);
+	callParamCallbacks();
+	return asynSuccess;
+}
+
+// single bits of the control word (bo/mbboDirect with MASK), the others are kept as read back
+asynStatus drvSCANDINOVA::writeUInt32Digital(asynUser *pasynUser, epicsUInt32 value, epicsUInt32 mask)
+{
+	int function = pasynUser->reason;
+	char strCmd[32];
+	epicsUInt32 nWord;
+	asynStatus status;
+
+	if(function != P_ControlCmd)
+		return asynPortDriver::writeUInt32Digital(pasynUser, value, mask);
+
+	nWord = ((epicsUInt32)nControlWord & ~mask) | (value & mask);
+	epicsSnprintf(strCmd, sizeof(strCmd), "{W|003|%04X}", nWord & 0xFFFF);
+	status = sendCommand(strCmd);
+	if(status != asynSuccess)
+	{
+		epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize,
+				"%s: write %s failed", portName, strCmd);
+		return status;
+	}
+	nControlWord = nWord;
+	setUIntDigitalParam(function, nWord, 0xFFFFFFFF);
+	callParamCallbacks();
+	return asynSuccess;
+}
+
+asynStatus drvSCANDINOVA::readFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements, size_t *nIn)
+{
+	int function = pasynUser->reason;
+	int nPing;
+	size_t n;
+
+	for(nPing=0;nPing!=SDN_PING_COUNT;++nPing)
+	{
+		if(function != P_PingValues[nPing])
+			continue;
+		n = (size_t)nValues[nPing] < nElements ? (size_t)nValues[nPing] : nElements;
+		memcpy(value, dbValues[nPing], n * sizeof(epicsFloat64));
+		*nIn = n;
+		return asynSuccess;
+	}
+	return asynPortDriver::readFloat64Array(pasynUser, value, nElements, nIn);
+}
+
+void drvSCANDINOVA::report(FILE *fp, int details)
+{
+	int nCount = 0;
+	int nErrors = 0;
+	int bConnected = 0;
+
+	getIntegerParam(P_PollCount, &nCount);
+	getIntegerParam(P_PollErrors, &nErrors);
+	getIntegerParam(P_Connected, &bConnected);
+	fprintf(fp, "drvSCANDINOVA %s: period %.3f sec, polls %d, errors %d, %s\n",
+			portName, dbPollPeriod, nCount, nErrors, bConnected ? "connected" : "not connected");
+	asynPortDriver::report(fp, details);
+}
+
+/* iocsh: drvSCANDINOVAConfigure(portName, octetPortName, pollPeriod) */
+extern "C" {
+
+int drvSCANDINOVAConfigure(const char *portName, const char *octetPortName, double dbPollPeriod)
+{
+	if(portName == NULL || octetPortName == NULL)
+	{
+		epicsPrintf("drvSCANDINOVAConfigure: portName and octetPortName are required\n");
+		return -1;
+	}
+	new drvSCANDINOVA(portName, octetPortName, dbPollPeriod > 0 ? dbPollPeriod : 1.0);
+	return 0;
+}
+
+static const iocshArg drvSCANDINOVAConfigureArg0 = {"portName", iocshArgString};
+static const iocshArg drvSCANDINOVAConfigureArg1 = {"octetPortName", iocshArgString};
+static const iocshArg drvSCANDINOVAConfigureArg2 = {"pollPeriod", iocshArgDouble};
+static const iocshArg * const drvSCANDINOVAConfigureArgs[] = {
+	&drvSCANDINOVAConfigureArg0, &drvSCANDINOVAConfigureArg1, &drvSCANDINOVAConfigureArg2};
+static const iocshFuncDef drvSCANDINOVAConfigureDef = {"drvSCANDINOVAConfigure", 3, drvSCANDINOVAConfigureArgs};
+
+static void drvSCANDINOVAConfigureCall(const iocshArgBuf *args)
+{
+	drvSCANDINOVAConfigure(args[0].sval, args[1].sval, args[2].dval);
+}
+
+static void drvSCANDINOVARegister(void)
+{
+	iocshRegister(&drvSCANDINOVAConfigureDef, drvSCANDINOVAConfigureCall);
+}
+epicsExportRegistrar(drvSCANDINOVARegister);
+
+}
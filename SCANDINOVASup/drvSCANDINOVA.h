@@ -0,0 +1,75 @@
+/*
+ * SCANDINOVA modulator asynPortDriver
+ *
+ * Alternative to the devGpib command table of devSCANDINOVA.c: one asyn
+ * port per modulator with a named parameter per modulator field, polled by
+ * its own thread and published through callbacks, so the standard asyn
+ * device support (asynFloat64, asynInt32, asynUInt32Digital,
+ * asynFloat64Waveform, SCAN="I/O Intr") can be used directly.
+ *
+ *   drvAsynIPPortConfigure("MOD1", "10.1.1.10:5000", 0, 0, 0)
+ *   drvSCANDINOVAConfigure("SDN1", "MOD1", 1.0)
+ */
+
+#ifndef DRVSCANDINOVA_H
+#define DRVSCANDINOVA_H
+
+#include <epicsEvent.h>
+#include <epicsTime.h>
+#include <asynPortDriver.h>
+
+#define SDN_PING_COUNT				4
+#define SDN_PING_MAX_VALUES			32
+
+class drvSCANDINOVA : public asynPortDriver
+{
+public:
+	drvSCANDINOVA(const char *portName, const char *octetPortName, double dbPeriod);
+
+	virtual asynStatus writeFloat64(asynUser *pasynUser, epicsFloat64 value);
+	virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+	virtual asynStatus writeUInt32Digital(asynUser *pasynUser, epicsUInt32 value, epicsUInt32 mask);
+	virtual asynStatus readFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements, size_t *nIn);
+	virtual void report(FILE *fp, int details);
+
+	void pollerThread();
+
+protected:
+	// read back (asynFloat64), first parameter of the ping table
+	int P_FirstField;
+
+	// status words (asynUInt32Digital)
+	int P_StateWord;
+	int P_ControlWord;
+
+	// commands
+	int P_StateCmd;				// asynInt32, {W|001|%04X}
+	int P_ControlCmd;			// asynUInt32Digital, {W|003|%04X}
+	int P_PrfCmd;				// asynInt32, {W|12C|%d}
+	int P_FirstCmd;				// asynFloat64 setpoints, see cmdTable
+
+	// raw values of each ping (asynFloat64Array)
+	int P_PingValues[SDN_PING_COUNT];
+
+	// poller
+	int P_PollPeriod;
+	int P_PollCount;
+	int P_PollErrors;
+	int P_Connected;
+	int P_PollJitter;			// asynFloat64, wakeup - scheduled (unit: ms)
+	int P_PollJitterMax;
+
+private:
+	asynStatus ping(int nPing);
+	asynStatus sendCommand(const char *strCmd);
+
+	asynUser *pasynUserOctet;
+	asynUser *pasynUserCmd;
+	epicsEventId wakeEvent;
+	double dbPollPeriod;
+	double dbValues[SDN_PING_COUNT][SDN_PING_MAX_VALUES];
+	int nValues[SDN_PING_COUNT];
+	int nControlWord;			// last commanded control word
+};
+
+#endif
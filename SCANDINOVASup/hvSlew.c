@@ -0,0 +1,204 @@
+/*
+ * SCANDINOVA HV slew generator
+ *
+ * Turns a HVPS target voltage into small setpoint increments at dbSlewRate
+ * (v/sec), written as {W|3EB|%.4f} dbUpdateRate times per second. Only one
+ * write per modulator is queued on the port at a time; trajectory points
+ * produced while it waits are merged into the next write, a write the busy
+ * port did not take within SLEW_WRITE_TIMEOUT is counted and queued again
+ * with the next point. Decreases are never
+ * ramped (trip recovery, alarm decrease), the caller writes them at once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <epicsStdio.h>
+#include <errlog.h>
+#include <epicsThread.h>
+#include <epicsMutex.h>
+#include <asynDriver.h>
+#include <asynOctet.h>
+
+#include "devSCANDINOVA.h"
+#include "scandinovaThread.h"
+
+#define SLEW_WRITE_TIMEOUT	1.0
+
+typedef struct
+{
+	int nDevIdx;
+	epicsMutexId lock;
+	asynUser *pasynUser;
+	asynOctet *pasynOctet;
+	void *octetPvt;
+	double dbPending;			// point waiting for the port
+	int bQueued;
+	int bDropped;				// dbPending timed out on the queue, sent again
+	epicsThreadId thread;		// created with the first target
+} HV_SLEW_PVT;
+
+static HV_SLEW_PVT slewPvt[MAX_SCANDINOVA_CNT];
+
+static void slewWriteCallback(asynUser *pasynUser)
+{
+	HV_SLEW_PVT *pPvt = (HV_SLEW_PVT*)pasynUser->userPvt;
+	char strCmd[64];
+	size_t nBytes;
+	double dbPoint;
+	epicsTimeStamp tNow;
+
+	epicsMutexMustLock(pPvt->lock);
+	dbPoint = pPvt->dbPending;
+	pPvt->bQueued = 0;
+	epicsMutexUnlock(pPvt->lock);
+
+	sprintf(strCmd,"{W|3EB|%.4f}",dbPoint);
+	pasynUser->timeout = SLEW_WRITE_TIMEOUT;
+	if(pPvt->pasynOctet->write(pPvt->octetPvt,pasynUser,strCmd,strlen(strCmd),&nBytes) != asynSuccess)
+	{
+		epicsPrintf("hvSlew[%d]: write failed: %s\n",pPvt->nDevIdx,pasynUser->errorMessage);
+		return;
+	}
+	// port thread, like the verified writes of devSCANDINOVA.c
+	epicsTimeGetCurrent(&tNow);
+	scandinovaVerifyStart(&SDN[pPvt->nDevIdx].VFY[SDN_VERIFY_HV],dbPoint,tNow.secPastEpoch + tNow.nsec * 1e-9);
+}
+
+// port busy past SLEW_WRITE_TIMEOUT: asyn dropped the request, the thread queues it again
+static void slewTimeoutCallback(asynUser *pasynUser)
+{
+	HV_SLEW_PVT *pPvt = (HV_SLEW_PVT*)pasynUser->userPvt;
+
+	epicsMutexMustLock(pPvt->lock);
+	pPvt->bQueued = 0;
+	pPvt->bDropped = 1;
+	++SDN[pPvt->nDevIdx].HVS.nDropped;
+	epicsMutexUnlock(pPvt->lock);
+}
+
+// pPvt->lock held
+static void queuePoint(HV_SLEW_PVT *pPvt, double dbPoint)
+{
+	SCANDINOVA_HV_SLEW_INFO *pSlew = &SDN[pPvt->nDevIdx].HVS;
+
+	pPvt->dbPending = dbPoint;
+	if(pPvt->bQueued)
+		++pSlew->nCoalesced;
+	else if(pasynManager->queueRequest(pPvt->pasynUser,asynQueuePriorityHigh,SLEW_WRITE_TIMEOUT) == asynSuccess)
+	{
+		pPvt->bQueued = 1;
+		pPvt->bDropped = 0;
+	}
+}
+
+static void runHvSlewThreadFunc(void *lParam)
+{
+	HV_SLEW_PVT *pPvt = (HV_SLEW_PVT*)lParam;
+	SCANDINOVA_HV_SLEW_INFO *pSlew = &SDN[pPvt->nDevIdx].HVS;
+	double dbPeriod;
+	double dbDiff;
+	double dbMaxStep;
+
+	while(1)
+	{
+		dbPeriod = pSlew->dbUpdateRate > 0 ? 1.0 / pSlew->dbUpdateRate : 1.0;
+		epicsThreadSleep(dbPeriod);
+
+		epicsMutexMustLock(pPvt->lock);
+		if(pSlew->bUse == 0 || pSlew->bActive == 0)
+		{
+			// the last point of a finished trajectory was dropped
+			if(pSlew->bUse && pPvt->bDropped && pPvt->bQueued == 0)
+				queuePoint(pPvt,pPvt->dbPending);
+			epicsMutexUnlock(pPvt->lock);
+			continue;
+		}
+
+		dbDiff = pSlew->dbTarget - pSlew->dbPoint;
+		dbMaxStep = pSlew->dbSlewRate * dbPeriod;
+		if(fabs(dbDiff) <= dbMaxStep || dbMaxStep <= 0)
+		{
+			pSlew->dbPoint = pSlew->dbTarget;
+			pSlew->bActive = 0;
+		}
+		else
+			pSlew->dbPoint += dbDiff > 0 ? dbMaxStep : -dbMaxStep;
+
+		queuePoint(pPvt,pSlew->dbPoint);
+		epicsMutexUnlock(pPvt->lock);
+	}
+}
+
+int hvSlewInit(int nDevIdx)
+{
+	HV_SLEW_PVT *pPvt = &slewPvt[nDevIdx];
+	asynInterface *pasynInterface;
+	char portName[32];
+
+	pPvt->nDevIdx = nDevIdx;
+	pPvt->lock = epicsMutexMustCreate();
+	SDN[nDevIdx].HVS.dbSlewRate = 5;		// (unit: v/sec)
+	SDN[nDevIdx].HVS.dbUpdateRate = 5;		// (unit: Hz)
+
+	// asyn port of the "#L<link> A<addr>" links, the ip port is not multi-device
+	sprintf(portName,"L%d",nDevIdx);
+	pPvt->pasynUser = pasynManager->createAsynUser(slewWriteCallback,slewTimeoutCallback);
+	pPvt->pasynUser->userPvt = pPvt;
+	if(pasynManager->connectDevice(pPvt->pasynUser,portName,0) != asynSuccess
+			|| (pasynInterface = pasynManager->findInterface(pPvt->pasynUser,asynOctetType,1)) == NULL)
+	{
+		epicsPrintf("hvSlew[%d]: cannot connect to port %s\n",nDevIdx,portName);
+		pasynManager->freeAsynUser(pPvt->pasynUser);
+		pPvt->pasynUser = NULL;
+		return -1;
+	}
+	pPvt->pasynOctet = (asynOctet*)pasynInterface->pinterface;
+	pPvt->octetPvt = pasynInterface->drvPvt;
+	return 0;
+}
+
+/*
+ * New target: start from the setpoint the modulator reports when the
+ * generator was idle (the setpoint may have been written directly).
+ * Below the current point: the trajectory stops there, a write still queued
+ * goes out with the new value, returns 1 and the caller writes it directly.
+ */
+int hvSlewSetTarget(int nDevIdx, double dbTarget)
+{
+	HV_SLEW_PVT *pPvt = &slewPvt[nDevIdx];
+	SCANDINOVA_HV_SLEW_INFO *pSlew = &SDN[nDevIdx].HVS;
+	char thName[64];
+	double dbFrom;
+
+	if(pPvt->pasynUser == NULL)
+		return -1;
+
+	epicsMutexMustLock(pPvt->lock);
+	if(pPvt->thread == NULL)
+	{
+		sprintf(thName,"HVSLEW#%d",nDevIdx);
+		pPvt->thread = scandinovaThreadCreate(SDN_THREAD_SLEW,thName,epicsThreadPriorityHigh,epicsThreadStackSmall,
+				(EPICSTHREADFUNC)runHvSlewThreadFunc,pPvt);
+	}
+
+	dbFrom = pSlew->bActive ? pSlew->dbPoint : SDN[nDevIdx].dbHVPSVoltSet;
+	if(dbTarget < dbFrom)
+	{
+		pSlew->bActive = 0;
+		pSlew->dbPoint = dbTarget;
+		pSlew->dbTarget = dbTarget;
+		if(pPvt->bQueued)
+			pPvt->dbPending = dbTarget;
+		pPvt->bDropped = 0;
+		epicsMutexUnlock(pPvt->lock);
+		return 1;
+	}
+	pSlew->dbPoint = dbFrom;
+	pSlew->dbTarget = dbTarget;
+	pSlew->bActive = 1;
+	epicsMutexUnlock(pPvt->lock);
+	return 0;
+}
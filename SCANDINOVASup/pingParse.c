@@ -0,0 +1,188 @@
+/*
+ * SCANDINOVA ping frame parser
+ *
+ * A reply "{p|00n|a|b|...}" (the closing brace is removed as input EOS) is
+ * split at '|' into result[0] = "p", result[1] = page and the fields. No
+ * EPICS dependency, so the device support, scandinovaTest and
+ * scandinovaFuzz share the same code. Frames with an overlong field, too
+ * many fields or too few fields for their page are rejected as a whole.
+ * The first fault latch of the state word lives here for the same reason.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "devSCANDINOVA.h"
+
+// fields a page must have to be stored (the last index read + 1)
+static const int pageMinTokens[MAX_SCANDINOVA_PAGE_COUNT] = {19, 11, 9, 2};
+
+/*
+ * Returns the token count, 0 when it is not a reply of strPrefix or does
+ * not fit into result.
+ */
+int scandinovaSplitPing(const char *recvBuf, size_t nRet, const char *strPrefix, char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN])
+{
+	int nCnt = 0;
+	int nIdx = 0;
+	const char *beg,*end;
+
+	if(nRet < 6 || strncmp(recvBuf,strPrefix,6) != 0)
+		return 0;
+
+	beg = &recvBuf[1];
+	end = &recvBuf[nRet];
+	while(beg<end)
+	{
+		if(*beg != '|')
+		{
+			if(nIdx == SDN_MAX_TOKEN_LEN - 1)
+				return 0;
+			result[nCnt][nIdx++] = *beg;
+		}
+		else
+		{
+			result[nCnt][nIdx] = '\0';
+			nIdx = 0;
+			if(++nCnt == SDN_MAX_TOKEN)
+				return 0;
+		}
+		++beg;
+	}
+	result[nCnt][nIdx] = '\0';
+	++nCnt;
+	return nCnt;
+}
+
+static void storePing0(SCANDINOVA_INFO *pInfo, char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN])
+{
+	pInfo->dbStateSet = strtoul(result[3],NULL,16);
+	pInfo->dbStateRead = strtoul(result[2],NULL,16);
+	pInfo->dbFilamentVoltRead = atof(result[4]);
+	pInfo->dbFilamentCurrRead = atof(result[5]);
+	pInfo->dbCtRead = atof(result[6]);
+	pInfo->dbCvdRead = atof(result[7]);
+	pInfo->dbCtArcPerSecondRead = strtoul(result[8],NULL,16);
+	pInfo->dbCvdArcPerSecondRead = strtoul(result[9],NULL,16);
+	pInfo->dbPrfRead = atof(result[10]);
+	pInfo->dbPlswthRead = atof(result[11]);
+	pInfo->dbPowRead = atof(result[12]);
+	pInfo->dbHVPSVoltRead = atof(result[13]);
+	pInfo->dbHVPSVoltSet = atof(result[14]);
+	pInfo->dbPlswthSet = atof(result[15]);
+	pInfo->dbPrfSet = atof(result[16]);
+	pInfo->dbRemainingTime = strtoul(result[17],NULL,16);
+	pInfo->dbAccessLevel = strtoul(result[18],NULL,16);
+}
+
+static void storePing1(SCANDINOVA_INFO *pInfo, char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN])
+{
+	pInfo->dbSolonoidPs1VoltRead = atof(result[2]);
+	pInfo->dbSolonoidPs1CurrRead = atof(result[3]);
+	pInfo->dbSolonoidPs1CurrSet = atof(result[4]);
+	pInfo->dbSolonoidPs2VoltRead = atof(result[5]);
+	pInfo->dbSolonoidPs2CurrRead = atof(result[6]);
+	pInfo->dbSolonoidPs3VoltRead = atof(result[7]);
+	pInfo->dbSolonoidPs3CurrRead = atof(result[8]);
+	pInfo->dbSolonoidPs4VoltRead = atof(result[9]);
+	pInfo->dbPresRead1 = atof(result[10]);
+}
+
+static void storePing2(SCANDINOVA_INFO *pInfo, char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN])
+{
+	pInfo->dbStandByCurrSet = atof(result[2]);
+	pInfo->dbSolonoidPs2CurrSet = atof(result[6]);
+	pInfo->dbControlWordSet = strtoul(result[3],NULL,16);
+	pInfo->dbSolonoidPs3CurrSet = atof(result[7]);
+	pInfo->dbSolonoidPs4CurrSet = atof(result[8]);
+	pInfo->dbSolonoidPs2CurrHighLimit = atof(result[4]);			// tunnel vacuum1 high limit
+	pInfo->dbSolonoidPs2CurrLowLimit = atof(result[5]);			// tunnel vacuum1 low limit
+}
+
+// fields a reply of nPage must have, also checked by drvSCANDINOVA
+int scandinovaPageMinTokens(int nPage)
+{
+	if(nPage < 0 || nPage >= MAX_SCANDINOVA_PAGE_COUNT)
+		return SDN_MAX_TOKEN + 1;
+	return pageMinTokens[nPage];
+}
+
+// 0: stored, -1: too few fields for the page (nothing changed)
+int scandinovaStorePing(SCANDINOVA_INFO *pInfo, int nPage, char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN], int nCnt)
+{
+	if(nPage < 0 || nPage >= MAX_SCANDINOVA_PAGE_COUNT || nCnt < pageMinTokens[nPage])
+		return -1;
+
+	switch(nPage)
+	{
+		case 0:	storePing0(pInfo,result); break;
+		case 1:	storePing1(pInfo,result); break;
+		case 2:	storePing2(pInfo,result); break;
+	}
+	return 0;
+}
+
+// split and store, 0: stored, -1: rejected
+int scandinovaParsePing(SCANDINOVA_INFO *pInfo, int nPage, const char *recvBuf, size_t nRet)
+{
+	char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN];
+	char strPrefix[16];
+	int nCnt;
+
+	if(nPage < 0 || nPage >= MAX_SCANDINOVA_PAGE_COUNT)
+		return -1;
+	sprintf(strPrefix,"{p|%03d",nPage);
+	nCnt = scandinovaSplitPing(recvBuf,nRet,strPrefix,result);
+	if(nCnt == 0)
+		return -1;
+	return scandinovaStorePing(pInfo,nPage,result,nCnt);
+}
+
+/*
+ * First fault latch: the first frame that sets a masked bit of the state
+ * word, or enters the fault mode, is kept (bits, words, receive time) until
+ * scandinovaFaultReset. Bits clearing and the mode changes of normal
+ * operation (standby, hv on, reset) do not latch. Bits changing within the
+ * same frame cannot be ordered, nFirstBit is the lowest of them.
+ */
+void scandinovaFaultSample(SCANDINOVA_FAULT_INFO *pFault, int nWord, double dbTime)
+{
+	int nChanged;
+	int nBit;
+
+	if(pFault->bValid == 0)
+	{
+		pFault->bValid = 1;
+		pFault->nLastWord = nWord;
+		return;
+	}
+
+	nChanged = nWord & ~pFault->nLastWord & pFault->nMask;
+	if((nWord & SDN_STATE_MODE_MASK) == SDN_STATE_MODE_FAULT
+			&& (pFault->nLastWord & SDN_STATE_MODE_MASK) != SDN_STATE_MODE_FAULT)
+		nChanged |= (nWord ^ pFault->nLastWord) & SDN_STATE_MODE_MASK;
+	if(nChanged != 0 && pFault->bLatched == 0)
+	{
+		for(nBit=0;(nChanged & (1 << nBit)) == 0;++nBit)
+			;
+		pFault->bLatched = 1;
+		pFault->nFirstBit = nBit;
+		pFault->nChangedMask = nChanged;
+		pFault->nWordBefore = pFault->nLastWord;
+		pFault->nWordAfter = nWord;
+		pFault->dbTime = dbTime;
+	}
+	pFault->nLastWord = nWord;
+}
+
+// operator reset, the next change latches again
+void scandinovaFaultReset(SCANDINOVA_FAULT_INFO *pFault)
+{
+	pFault->bLatched = 0;
+	pFault->nFirstBit = -1;
+	pFault->nChangedMask = 0;
+	pFault->nWordBefore = 0;
+	pFault->nWordAfter = 0;
+	pFault->dbTime = 0;
+}
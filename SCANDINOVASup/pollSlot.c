@@ -0,0 +1,82 @@
+/*
+ * SCANDINOVA poll slot logic
+ *
+ * Slot placement and the per slot bookkeeping of the poll scheduler. No
+ * EPICS dependency, scandinovaPoll.c calls it with pollLock held,
+ * scandinovaTest directly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "devSCANDINOVA.h"
+
+// slot offsets of the scheduled modulators in list order, next slots from the common start
+void scandinovaPollPlace(SCANDINOVA_POLL_INFO *pList[], int nCount, double dbStart, double dbNow)
+{
+	SCANDINOVA_POLL_INFO *pPoll;
+	int nUse = 0;
+	int k = 0;
+	int i;
+	double dbSlot;
+
+	for(i=0;i!=nCount;++i)
+		nUse += pList[i]->bUse;
+
+	for(i=0;i!=nCount;++i)
+	{
+		pPoll = pList[i];
+		if(pPoll->bUse == 0)
+			continue;
+		if(pPoll->dbPhase >= 0)
+			pPoll->dbPhaseUsed = fmod(pPoll->dbPhase, pPoll->dbPeriod);
+		else
+			pPoll->dbPhaseUsed = pPoll->dbPeriod * k / nUse;
+		++k;
+
+		dbSlot = dbStart + pPoll->dbPhaseUsed;
+		if(dbSlot < dbNow)
+			dbSlot += ceil((dbNow - dbSlot) / pPoll->dbPeriod) * pPoll->dbPeriod;
+		pPoll->dbNext = dbSlot;
+	}
+}
+
+// a due slot: counts the outcome of the previous poll and moves to the next slot
+void scandinovaPollFire(SCANDINOVA_POLL_INFO *pPoll, double dbNow)
+{
+	int nLate;
+
+	// a whole period late: those slots are gone, the phase is kept
+	nLate = (int)floor((dbNow - pPoll->dbNext) / pPoll->dbPeriod);
+	pPoll->nMissed += nLate;
+	pPoll->dbNext += (nLate + 1) * pPoll->dbPeriod;
+
+	if(pPoll->dbFired > 0 && pPoll->bDone == 0)
+	{
+		if(pPoll->bAnswered)
+			++pPoll->nOverruns;
+		else
+			++pPoll->nNoReply;
+	}
+	pPoll->dbFired = dbNow;
+	pPoll->bAnswered = 0;
+	pPoll->bDone = 0;
+	++pPoll->nPolls;
+}
+
+// a decoded ping of the current poll
+void scandinovaPollAnswer(SCANDINOVA_POLL_INFO *pPoll, int nPage, double dbTime)
+{
+	if(pPoll->bUse == 0 || pPoll->dbFired <= 0 || dbTime < pPoll->dbFired)
+		return;
+	if(nPage == 0)
+		pPoll->bAnswered = 1;
+	else if(nPage == MAX_SCANDINOVA_PAGE_COUNT - 1 && pPoll->bDone == 0)
+	{
+		pPoll->bDone = 1;
+		pPoll->dbLatency = dbTime - pPoll->dbFired;
+		pPoll->dbLatencyMax = fmax(pPoll->dbLatencyMax, pPoll->dbLatency);
+	}
+}
@@ -0,0 +1,296 @@
+/*
+ * SCANDINOVA station group ramp scheduler
+ *
+ * Modulators that share a supply or cooling are put into a group before
+ * iocInit:
+ *
+ *   scandinovaGroupConfigure("KLY", "0,1,2", 120.0, 300.0)
+ *
+ * with the group power budget (same unit as the POW read back, <= 0: none)
+ * and the hv step budget of the whole group (unit: v/min, <= 0: none).
+ *
+ * Every auto drive channel of a member asks for each hv increase (grantStep
+ * of the auto drive ops). Once a second the group collects the pending
+ * requests and ranks them (rampGroupRank.c): by vacuum headroom of the
+ * channel, granted in that order while the power and hv budgets hold. The
+ * others are deferred and ask again with their next step. A step larger
+ * than the whole hv budget is logged once and granted when the budget is
+ * full. Devices not in a group are always granted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <epicsStdio.h>
+#include <errlog.h>
+#include <epicsThread.h>
+#include <epicsMutex.h>
+#include <epicsTime.h>
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include "devSCANDINOVA.h"
+#include "scandinovaThread.h"
+
+#define RAMP_GROUP_PERIOD		1.0		// (unit: sec)
+#define RAMP_GROUP_GRANT_TIMEOUT	5.0		// an unused grant expires (unit: sec)
+#define MAX_RAMP_GROUP_CNT		8
+
+typedef struct
+{
+	char name[32];
+	int nMembers;
+	int nMember[MAX_SCANDINOVA_CNT];
+	double dbPowerBudget;
+	double dbDvBudget;
+	double dbDvLeft;
+	epicsMutexId lock;
+	epicsThreadId thread;
+	SCANDINOVA_RAMP_REQUEST req[MAX_SCANDINOVA_CNT][MAX_SCANDINOVA_VACUUM_COUNT];
+} RAMP_GROUP;
+
+static RAMP_GROUP rampGroup[MAX_RAMP_GROUP_CNT];
+static int nRampGroups = 0;
+static RAMP_GROUP *deviceGroup[MAX_SCANDINOVA_CNT];
+
+static double rampGroupTime(void)
+{
+	epicsTimeStamp tNow;
+	epicsTimeGetCurrent(&tNow);
+	return tNow.secPastEpoch + tNow.nsec * 1e-9;
+}
+
+// vacuum headroom of the gauge of a channel, 1: far from the alarm, 0: at the alarm
+static double channelHeadroom(const SCANDINOVA_AUTO_DRIVE_INFO *p)
+{
+	if(p->dbVacuum == NULL || p->dbAlarmHighLimit <= p->dbTripLowLimit)
+		return 1;
+	return fmin(fmax((p->dbAlarmHighLimit - *p->dbVacuum) / (p->dbAlarmHighLimit - p->dbTripLowLimit), 0), 1);
+}
+
+static void rampGroupSchedule(RAMP_GROUP *pGrp, double dbDt)
+{
+	SCANDINOVA_RAMP_REQUEST *pList[MAX_SCANDINOVA_CNT * MAX_SCANDINOVA_VACUUM_COUNT];
+	SCANDINOVA_RAMP_REQUEST *pReq;
+	SCANDINOVA_SCHED_INFO *pSch;
+	SCANDINOVA_SCHED_INFO sch;
+	double dbNow = rampGroupTime();
+	int nReq = 0;
+	int nDevIdx;
+	int nIdx;
+	int i;
+
+	if(pGrp->dbDvBudget > 0)
+		pGrp->dbDvLeft = fmin(pGrp->dbDvBudget, pGrp->dbDvLeft + pGrp->dbDvBudget / 60.0 * dbDt);
+
+	memset(&sch,0,sizeof(sch));
+	sch.dbPowerBudget = pGrp->dbPowerBudget;
+	sch.dbDvBudget = pGrp->dbDvBudget;
+	sch.dbDvLeft = pGrp->dbDvLeft;
+	for(i = 0; i < pGrp->nMembers; i++)
+	{
+		nDevIdx = pGrp->nMember[i];
+		sch.dbGroupPower += SDN[nDevIdx].dbPowRead;
+		SDN[nDevIdx].SCH.nRank = 0;
+
+		for(nIdx = 0; nIdx < MAX_SCANDINOVA_VACUUM_COUNT; nIdx++)
+		{
+			pReq = &pGrp->req[nDevIdx][nIdx];
+			pReq->dbPowRead = SDN[nDevIdx].dbPowRead;
+			if(pReq->bGranted && dbNow - pReq->dbGrantTime > RAMP_GROUP_GRANT_TIMEOUT)
+				pReq->bGranted = 0;
+			if(pReq->bGranted)
+				sch.dbGroupPower += rampGroupPredictPower(pReq);		// not on the read back yet
+			else if(pReq->bPending)
+			{
+				pReq->dbHeadroom = channelHeadroom(&SDN[nDevIdx].SADI[nIdx]);
+				pList[nReq++] = pReq;
+			}
+		}
+	}
+	rampGroupRank(pList, nReq, &sch, dbNow);
+	pGrp->dbDvLeft = sch.dbDvLeft;
+
+	for(i = 0; i < nReq; i++)
+	{
+		pReq = pList[i];
+		pSch = &SDN[pReq->nDevIdx].SCH;
+		if(pSch->nRank == 0 || pReq->nRank < pSch->nRank)
+			pSch->nRank = pReq->nRank;
+		if(pReq->bGranted == 0)
+			pSch->nDefers++;
+		if(pReq->bOversize && pReq->bOversizeLogged == 0)
+		{
+			epicsPrintf("rampGroup %s: step %.2f -> %.2f V of [%d][%d] exceeds the hv budget %.2f V/min, granted when the budget is full\n",
+					pGrp->name,pReq->dbFrom,pReq->dbTo,pReq->nDevIdx,pReq->nIdx,pGrp->dbDvBudget);
+			pReq->bOversizeLogged = 1;
+		}
+	}
+
+	for(i = 0; i < pGrp->nMembers; i++)
+	{
+		nDevIdx = pGrp->nMember[i];
+		SDN[nDevIdx].SCH.dbGroupPower = sch.dbGroupPower;
+		SDN[nDevIdx].SCH.dbPowerBudget = pGrp->dbPowerBudget;
+		SDN[nDevIdx].SCH.dbDvLeft = pGrp->dbDvLeft;
+		SDN[nDevIdx].SCH.dbDvBudget = pGrp->dbDvBudget;
+	}
+}
+
+static void runRampGroupThreadFunc(void *lParam)
+{
+	RAMP_GROUP *pGrp = (RAMP_GROUP *)lParam;
+
+	while(1)
+	{
+		epicsThreadSleep(RAMP_GROUP_PERIOD);
+
+		epicsMutexMustLock(pGrp->lock);
+		rampGroupSchedule(pGrp, RAMP_GROUP_PERIOD);
+		epicsMutexUnlock(pGrp->lock);
+	}
+}
+
+int scandinovaGroupConfigure(const char *name, const char *members, double dbPowerBudget, double dbDvBudget)
+{
+	RAMP_GROUP *pGrp;
+	char buf[256];
+	char *pTok;
+	char *pSave;
+	int nDevIdx;
+	int nIdx;
+
+	if(name == NULL || members == NULL || nRampGroups >= MAX_RAMP_GROUP_CNT)
+	{
+		epicsPrintf("scandinovaGroupConfigure: name and members are required, up to %d groups\n",MAX_RAMP_GROUP_CNT);
+		return -1;
+	}
+	pGrp = &rampGroup[nRampGroups];
+	memset(pGrp,0,sizeof(RAMP_GROUP));
+	strncpy(pGrp->name,name,sizeof(pGrp->name)-1);
+	pGrp->dbPowerBudget = dbPowerBudget;
+	pGrp->dbDvBudget = dbDvBudget;
+	pGrp->dbDvLeft = dbDvBudget > 0 ? dbDvBudget : 0;
+
+	strncpy(buf,members,sizeof(buf)-1);
+	buf[sizeof(buf)-1] = '\0';
+	for(pTok = strtok_r(buf,", ",&pSave); pTok; pTok = strtok_r(NULL,", ",&pSave))
+	{
+		nDevIdx = atoi(pTok);
+		if(nDevIdx < 0 || nDevIdx >= MAX_SCANDINOVA_CNT || deviceGroup[nDevIdx])
+		{
+			epicsPrintf("scandinovaGroupConfigure: %s, device %s is out of range or already in a group\n",name,pTok);
+			continue;
+		}
+		pGrp->nMember[pGrp->nMembers++] = nDevIdx;
+		deviceGroup[nDevIdx] = pGrp;
+		for(nIdx = 0; nIdx < MAX_SCANDINOVA_VACUUM_COUNT; nIdx++)
+		{
+			pGrp->req[nDevIdx][nIdx].nDevIdx = nDevIdx;
+			pGrp->req[nDevIdx][nIdx].nIdx = nIdx;
+			pGrp->req[nDevIdx][nIdx].nOrder = nDevIdx * MAX_SCANDINOVA_VACUUM_COUNT + nIdx;
+		}
+	}
+	if(pGrp->nMembers == 0)
+	{
+		epicsPrintf("scandinovaGroupConfigure: %s has no members\n",name);
+		return -1;
+	}
+	nRampGroups++;
+	return 0;
+}
+
+// from init_ai, after SDN was cleared
+int rampGroupInit(void)
+{
+	RAMP_GROUP *pGrp;
+	char thName[64];
+	int i, j;
+
+	for(i = 0; i < nRampGroups; i++)
+	{
+		pGrp = &rampGroup[i];
+		for(j = 0; j < pGrp->nMembers; j++)
+		{
+			SDN[pGrp->nMember[j]].SCH.nGroup = i + 1;
+			SDN[pGrp->nMember[j]].SCH.dbPowerBudget = pGrp->dbPowerBudget;
+			SDN[pGrp->nMember[j]].SCH.dbDvBudget = pGrp->dbDvBudget;
+			SDN[pGrp->nMember[j]].SCH.dbDvLeft = pGrp->dbDvLeft;
+		}
+		if(pGrp->thread)
+			continue;
+		pGrp->lock = epicsMutexMustCreate();
+		sprintf(thName,"RAMPGROUP#%d",i);
+		pGrp->thread = scandinovaThreadCreate(SDN_THREAD_GROUP,thName,epicsThreadPriorityMedium,epicsThreadStackSmall,
+				(EPICSTHREADFUNC)runRampGroupThreadFunc,pGrp);
+	}
+	return 0;
+}
+
+// auto drive side: 1 when the step may be made now, else it is queued for the next schedule
+int rampGroupGrant(int nDevIdx, int nIdx, double dbFrom, double dbTo)
+{
+	RAMP_GROUP *pGrp;
+	SCANDINOVA_RAMP_REQUEST *pReq;
+	int bGrant = 0;
+
+	if(nDevIdx < 0 || nDevIdx >= MAX_SCANDINOVA_CNT || (pGrp = deviceGroup[nDevIdx]) == NULL || pGrp->thread == NULL)
+		return 1;
+	if(nIdx < 0 || nIdx >= MAX_SCANDINOVA_VACUUM_COUNT)
+		return 0;
+
+	pReq = &pGrp->req[nDevIdx][nIdx];
+	epicsMutexMustLock(pGrp->lock);
+	if(pReq->bGranted)
+	{
+		pReq->bGranted = 0;
+		SDN[nDevIdx].SCH.nGrants++;
+		bGrant = 1;
+	}
+	else
+	{
+		pReq->bPending = 1;
+		pReq->dbFrom = dbFrom;
+		pReq->dbTo = dbTo;
+	}
+	epicsMutexUnlock(pGrp->lock);
+	return bGrant;
+}
+
+int rampGroupSetBudget(int nDevIdx, double dbPowerBudget, double dbDvBudget)
+{
+	RAMP_GROUP *pGrp;
+
+	if(nDevIdx < 0 || nDevIdx >= MAX_SCANDINOVA_CNT || (pGrp = deviceGroup[nDevIdx]) == NULL || pGrp->thread == NULL)
+		return -1;
+
+	epicsMutexMustLock(pGrp->lock);
+	pGrp->dbPowerBudget = dbPowerBudget;
+	pGrp->dbDvBudget = dbDvBudget;
+	if(dbDvBudget > 0)
+		pGrp->dbDvLeft = fmin(pGrp->dbDvLeft, dbDvBudget);
+	epicsMutexUnlock(pGrp->lock);
+	return 0;
+}
+
+/* iocsh: scandinovaGroupConfigure(name, members, powerBudget, dvBudget) */
+static const iocshArg scandinovaGroupConfigureArg0 = {"name", iocshArgString};
+static const iocshArg scandinovaGroupConfigureArg1 = {"members", iocshArgString};
+static const iocshArg scandinovaGroupConfigureArg2 = {"powerBudget", iocshArgDouble};
+static const iocshArg scandinovaGroupConfigureArg3 = {"dvBudget", iocshArgDouble};
+static const iocshArg * const scandinovaGroupConfigureArgs[] = {
+	&scandinovaGroupConfigureArg0, &scandinovaGroupConfigureArg1, &scandinovaGroupConfigureArg2, &scandinovaGroupConfigureArg3};
+static const iocshFuncDef scandinovaGroupConfigureDef = {"scandinovaGroupConfigure", 4, scandinovaGroupConfigureArgs};
+
+static void scandinovaGroupConfigureCall(const iocshArgBuf *args)
+{
+	scandinovaGroupConfigure(args[0].sval, args[1].sval, args[2].dval, args[3].dval);
+}
+
+static void scandinovaGroupRegister(void)
+{
+	iocshRegister(&scandinovaGroupConfigureDef, scandinovaGroupConfigureCall);
+}
+epicsExportRegistrar(scandinovaGroupRegister);
@@ -0,0 +1,85 @@
+/*
+ * SCANDINOVA station group grant ranking
+ *
+ * One schedule of the pending hv step requests of a group: ranked by vacuum
+ * headroom and granted in that order while the group power plus the
+ * predicted rise of the granted steps (P ~ V^2.5 of a klystron) stays within
+ * the power budget and the step fits the hv budget left. No EPICS
+ * dependency, rampGroup.c calls it once a second, scandinovaTest directly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "devSCANDINOVA.h"
+
+#define RAMP_GROUP_POWER_EXP	2.5		// klystron perveance, P ~ V^2.5
+
+// power rise of a step from the present read back
+double rampGroupPredictPower(const SCANDINOVA_RAMP_REQUEST *pReq)
+{
+	if(pReq->dbFrom <= 0 || pReq->dbTo <= pReq->dbFrom || pReq->dbPowRead <= 0)
+		return 0;
+	return pReq->dbPowRead * (pow(pReq->dbTo / pReq->dbFrom, RAMP_GROUP_POWER_EXP) - 1);
+}
+
+// most headroom first, equal headroom in request order
+static int compareHeadroom(const void *a, const void *b)
+{
+	const SCANDINOVA_RAMP_REQUEST *pA = *(const SCANDINOVA_RAMP_REQUEST * const *)a;
+	const SCANDINOVA_RAMP_REQUEST *pB = *(const SCANDINOVA_RAMP_REQUEST * const *)b;
+
+	if(pA->dbHeadroom > pB->dbHeadroom) return -1;
+	if(pA->dbHeadroom < pB->dbHeadroom) return 1;
+	if(pA->nOrder < pB->nOrder) return -1;
+	if(pA->nOrder > pB->nOrder) return 1;
+	return 0;
+}
+
+/*
+ * pSch: dbGroupPower (measured plus granted, not yet read back) and dbDvLeft
+ * are updated with the new grants. A step larger than the whole hv budget
+ * never fits; it is flagged bOversize and granted when the budget is full.
+ * Returns the number of grants.
+ */
+int rampGroupRank(SCANDINOVA_RAMP_REQUEST *pList[], int nReq, SCANDINOVA_SCHED_INFO *pSch, double dbNow)
+{
+	SCANDINOVA_RAMP_REQUEST *pReq;
+	double dbStep;
+	double dbRise;
+	int bFits;
+	int nGrants = 0;
+	int i;
+
+	qsort(pList, nReq, sizeof(pList[0]), compareHeadroom);
+
+	for(i = 0; i < nReq; i++)
+	{
+		pReq = pList[i];
+		pReq->nRank = i + 1;
+		pReq->bPending = 0;
+		dbStep = pReq->dbTo - pReq->dbFrom;
+		dbRise = rampGroupPredictPower(pReq);
+
+		pReq->bOversize = pSch->dbDvBudget > 0 && dbStep > pSch->dbDvBudget;
+		if(pSch->dbDvBudget <= 0)
+			bFits = 1;
+		else if(pReq->bOversize)
+			bFits = pSch->dbDvLeft >= pSch->dbDvBudget;
+		else
+			bFits = dbStep <= pSch->dbDvLeft;
+
+		if(bFits && (pSch->dbPowerBudget <= 0 || pSch->dbGroupPower + dbRise <= pSch->dbPowerBudget))
+		{
+			pReq->bGranted = 1;
+			pReq->dbGrantTime = dbNow;
+			pSch->dbGroupPower += dbRise;
+			if(pSch->dbDvBudget > 0)
+				pSch->dbDvLeft = fmax(0, pSch->dbDvLeft - dbStep);
+			++nGrants;
+		}
+	}
+	return nGrants;
+}
@@ -0,0 +1,403 @@
+/*
+ * SCANDINOVA conditioning recipe engine
+ *
+ * scandinovaRecipeConfigure(dev, "recipe.txt", "recipe.state") before
+ * iocInit loads a step table, one step per line ('#' starts a comment):
+ *
+ *   # hv    prf  plswth  dwell  vacAdv  arcAdv  vacBack  arcBack
+ *     900   10   -       3600   3.6     0.1     4.8      1.0
+ *     950   25   2.5     7200   3.6     0.1     4.8      1.0
+ *
+ * '-' leaves PRF or pulse width unchanged. A step writes its setpoints, the
+ * dwell counts while the hv read back is at the target and vacuum and arc
+ * rate are below the advance gate; at or above the back off gate the
+ * previous step is taken again, once until both fall below the advance gate
+ * (recipeEngine.c). With the master auto drive enabled the target becomes
+ * its dbHVMaxPoint, so the ramp keeps the vacuum protection; stop and done
+ * give it back the max point it had before the run.
+ *
+ * State, step, dwell, back offs and the max point before the run are
+ * written to the state file on every change, a restarted IOC continues from
+ * there (a running recipe waits for valid data first). The max point goes
+ * to the auto drive thread of the master, which takes it on its next loop.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <epicsStdio.h>
+#include <errlog.h>
+#include <epicsThread.h>
+#include <epicsMutex.h>
+#include <epicsTime.h>
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include "devSCANDINOVA.h"
+#include "scandinovaThread.h"
+
+#define RECIPE_PERIOD			1.0		// (unit: sec)
+#define RECIPE_SAVE_PERIOD		10.0	// dwell progress saved this often (unit: sec)
+#define RECIPE_MAX_STEPS		1000
+
+typedef struct
+{
+	char recipeFile[256];
+	char stateFile[256];
+	epicsMutexId lock;
+	epicsThreadId thread;
+	double dbLastSave;
+} RECIPE_PVT;
+
+static RECIPE_PVT recipePvt[MAX_SCANDINOVA_CNT];
+
+static double recipeTime(void)
+{
+	epicsTimeStamp tNow;
+	epicsTimeGetCurrent(&tNow);
+	return tNow.secPastEpoch + tNow.nsec * 1e-9;
+}
+
+// "-" -> -1 (unchanged)
+static double parseValue(const char *str)
+{
+	if(strcmp(str,"-") == 0)
+		return -1;
+	return atof(str);
+}
+
+static int loadRecipe(int nDevIdx, const char *fileName)
+{
+	SCANDINOVA_RECIPE_INFO *pRcp = &SDN[nDevIdx].RCP;
+	SCANDINOVA_RECIPE_STEP *pSteps;
+	SCANDINOVA_RECIPE_STEP *pStep;
+	char line[512];
+	char col[8][64];
+	char *pComment;
+	int nLine = 0;
+	int nCnt = 0;
+	FILE *fp;
+
+	fp = fopen(fileName,"r");
+	if(fp == NULL)
+	{
+		epicsPrintf("recipe[%d]: cannot open %s\n",nDevIdx,fileName);
+		return -1;
+	}
+	pSteps = (SCANDINOVA_RECIPE_STEP*)calloc(RECIPE_MAX_STEPS,sizeof(SCANDINOVA_RECIPE_STEP));
+
+	while(fgets(line,sizeof(line),fp))
+	{
+		++nLine;
+		if((pComment = strchr(line,'#')) != NULL)
+			*pComment = '\0';
+		if(sscanf(line,"%63s",col[0]) != 1)
+			continue;
+		if(sscanf(line,"%63s %63s %63s %63s %63s %63s %63s %63s",
+					col[0],col[1],col[2],col[3],col[4],col[5],col[6],col[7]) != 8)
+		{
+			epicsPrintf("recipe[%d]: %s:%d: 8 columns expected\n",nDevIdx,fileName,nLine);
+			fclose(fp);
+			free(pSteps);
+			return -1;
+		}
+		if(nCnt == RECIPE_MAX_STEPS)
+		{
+			epicsPrintf("recipe[%d]: %s: more than %d steps\n",nDevIdx,fileName,RECIPE_MAX_STEPS);
+			break;
+		}
+		pStep = &pSteps[nCnt++];
+		pStep->dbHv = atof(col[0]);
+		pStep->dbPrf = parseValue(col[1]);
+		pStep->dbPlswth = parseValue(col[2]);
+		pStep->dbDwell = atof(col[3]);
+		pStep->dbVacAdvance = atof(col[4]);
+		pStep->dbArcAdvance = atof(col[5]);
+		pStep->dbVacBackoff = atof(col[6]);
+		pStep->dbArcBackoff = atof(col[7]);
+	}
+	fclose(fp);
+
+	if(nCnt == 0)
+	{
+		epicsPrintf("recipe[%d]: %s: no steps\n",nDevIdx,fileName);
+		free(pSteps);
+		return -1;
+	}
+
+	free(pRcp->pSteps);
+	pRcp->pSteps = pSteps;
+	pRcp->nStepCount = nCnt;
+	epicsPrintf("recipe[%d]: %d steps loaded from %s\n",nDevIdx,nCnt,fileName);
+	return 0;
+}
+
+// written to a temporary file first, a crash never leaves a half state file
+static void saveState(int nDevIdx)
+{
+	RECIPE_PVT *pPvt = &recipePvt[nDevIdx];
+	SCANDINOVA_RECIPE_INFO *pRcp = &SDN[nDevIdx].RCP;
+	char tmpName[300];
+	FILE *fp;
+
+	pPvt->dbLastSave = recipeTime();
+	if(pPvt->stateFile[0] == '\0')
+		return;
+
+	sprintf(tmpName,"%s.tmp",pPvt->stateFile);
+	fp = fopen(tmpName,"w");
+	if(fp == NULL)
+	{
+		epicsPrintf("recipe[%d]: cannot write %s\n",nDevIdx,tmpName);
+		return;
+	}
+	fprintf(fp,"%d %d %.1f %d %d %.4f\n",pRcp->nState,pRcp->nStep,pRcp->dbDwellDone,pRcp->nBackoffs,
+			pRcp->bMaxPointSaved,pRcp->dbSavedMaxPoint);
+	if(fclose(fp) != 0 || rename(tmpName,pPvt->stateFile) != 0)
+		epicsPrintf("recipe[%d]: cannot write %s\n",nDevIdx,pPvt->stateFile);
+}
+
+static void restoreState(int nDevIdx)
+{
+	RECIPE_PVT *pPvt = &recipePvt[nDevIdx];
+	SCANDINOVA_RECIPE_INFO *pRcp = &SDN[nDevIdx].RCP;
+	int nState,nStep,nBackoffs;
+	int bMaxPointSaved = 0;
+	double dbDwellDone;
+	double dbSavedMaxPoint = 0;
+	FILE *fp;
+
+	if(pPvt->stateFile[0] == '\0' || (fp = fopen(pPvt->stateFile,"r")) == NULL)
+		return;
+	// the max point of the run is missing in a state file of an older version
+	if(fscanf(fp,"%d %d %lf %d %d %lf",&nState,&nStep,&dbDwellDone,&nBackoffs,&bMaxPointSaved,&dbSavedMaxPoint) >= 4
+			&& nState >= RCP_STATE_IDLE && nState <= RCP_STATE_DONE
+			&& nStep >= 0 && nStep <= pRcp->nStepCount)
+	{
+		pRcp->nState = nState;
+		pRcp->nStep = nStep;
+		pRcp->dbDwellDone = dbDwellDone;
+		pRcp->nBackoffs = nBackoffs;
+		pRcp->bMaxPointSaved = bMaxPointSaved;
+		pRcp->dbSavedMaxPoint = dbSavedMaxPoint;
+		epicsPrintf("recipe[%d]: restored state %d at step %d/%d\n",nDevIdx,nState,nStep+1,pRcp->nStepCount);
+	}
+	fclose(fp);
+}
+
+static void updateProgress(SCANDINOVA_RECIPE_INFO *pRcp)
+{
+	double dbTotal = 0;
+	double dbDone = 0;
+	int i;
+
+	for(i=0;i!=pRcp->nStepCount;++i)
+	{
+		dbTotal += pRcp->pSteps[i].dbDwell;
+		if(i < pRcp->nStep)
+			dbDone += pRcp->pSteps[i].dbDwell;
+	}
+	if(pRcp->nStep < pRcp->nStepCount)
+		dbDone += fmin(pRcp->dbDwellDone,pRcp->pSteps[pRcp->nStep].dbDwell);
+
+	pRcp->dbProgress = dbTotal > 0 ? dbDone * 100.0 / dbTotal : 100.0;
+	pRcp->dbEta = dbTotal - dbDone;
+}
+
+static void applyStep(int nDevIdx, const SCANDINOVA_RECIPE_STEP *pStep)
+{
+	SCANDINOVA_INFO *pInfo = &SDN[nDevIdx];
+	SCANDINOVA_AUTO_DRIVE_INFO *pMaster = &pInfo->SADI[0];
+
+	if(pStep->dbPrf >= 0 && (int)pStep->dbPrf != (int)pInfo->dbPrfSet)
+		prfSet(nDevIdx,(int)pStep->dbPrf);
+	if(pStep->dbPlswth >= 0 && fabs(pStep->dbPlswth - pInfo->dbPlswthSet) > 1e-4)
+		plswthSet(nDevIdx,pStep->dbPlswth);
+
+	// the auto drive only ramps up, a lower target is set directly
+	if(pMaster->bUse)
+		scandinovaSetMaxPoint(nDevIdx,0,pStep->dbHv);
+	if(pMaster->bUse == 0 || pStep->dbHv < pInfo->dbHVPSVoltSet)
+		setHv(nDevIdx,pStep->dbHv);
+}
+
+// master auto drive limit before the run, set again on stop and done
+static void saveMaxPoint(int nDevIdx)
+{
+	SCANDINOVA_RECIPE_INFO *pRcp = &SDN[nDevIdx].RCP;
+
+	if(pRcp->bMaxPointSaved)
+		return;
+	pRcp->dbSavedMaxPoint = scandinovaMaxPoint(nDevIdx,0);
+	pRcp->bMaxPointSaved = 1;
+}
+
+static void restoreMaxPoint(int nDevIdx)
+{
+	SCANDINOVA_RECIPE_INFO *pRcp = &SDN[nDevIdx].RCP;
+
+	if(pRcp->bMaxPointSaved == 0)
+		return;
+	scandinovaSetMaxPoint(nDevIdx,0,pRcp->dbSavedMaxPoint);
+	pRcp->bMaxPointSaved = 0;
+}
+
+static void recipeProcess(int nDevIdx, double dbDt)
+{
+	SCANDINOVA_INFO *pInfo = &SDN[nDevIdx];
+	SCANDINOVA_RECIPE_INFO *pRcp = &pInfo->RCP;
+	SCANDINOVA_AUTO_DRIVE_INFO *pMaster = &pInfo->SADI[0];
+	double dbVacuum;
+	double dbArc;
+
+	if(pRcp->nState != RCP_STATE_RUN)
+		return;
+	// no decisions on missing or old data
+	if(pInfo->bReady == 0 || recipeTime() - pInfo->dbPageTime[0] > pInfo->dbStaleLimit
+			|| recipeTime() - pInfo->dbPageTime[1] > pInfo->dbStaleLimit)
+		return;
+
+	if(pRcp->nStep < pRcp->nStepCount && pRcp->bApplied == 0)
+	{
+		applyStep(nDevIdx,&pRcp->pSteps[pRcp->nStep]);
+		pRcp->bApplied = 1;
+	}
+
+	dbVacuum = *pMaster->dbVacuum;
+	if(pMaster->bUse)
+		dbArc = pMaster->dbArcRateFilt;
+	else
+		dbArc = pInfo->dbCtArcPerSecondRead + pInfo->dbCvdArcPerSecondRead;
+
+	switch(recipeEvaluate(pRcp,dbVacuum,dbArc,pInfo->dbHVPSVoltRead,dbDt))
+	{
+		case RCP_EVENT_BACKOFF:
+			epicsPrintf("recipe[%d]: back off to step %d (vacuum %.3f, arc %.3f)\n",nDevIdx,pRcp->nStep+1,dbVacuum,dbArc);
+			saveState(nDevIdx);
+			break;
+		case RCP_EVENT_ADVANCE:
+			saveState(nDevIdx);
+			break;
+		case RCP_EVENT_DONE:
+			epicsPrintf("recipe[%d]: done\n",nDevIdx);
+			restoreMaxPoint(nDevIdx);
+			saveState(nDevIdx);
+			break;
+		default:
+			if(recipeTime() - recipePvt[nDevIdx].dbLastSave >= RECIPE_SAVE_PERIOD)
+				saveState(nDevIdx);
+			break;
+	}
+}
+
+static void runRecipeThreadFunc(void *lParam)
+{
+	int nDevIdx = (int)(size_t)lParam;
+	RECIPE_PVT *pPvt = &recipePvt[nDevIdx];
+
+	while(1)
+	{
+		epicsThreadSleep(RECIPE_PERIOD);
+
+		epicsMutexMustLock(pPvt->lock);
+		recipeProcess(nDevIdx,RECIPE_PERIOD);
+		updateProgress(&SDN[nDevIdx].RCP);
+		epicsMutexUnlock(pPvt->lock);
+	}
+}
+
+int scandinovaRecipeConfigure(int nDevIdx, const char *recipeFile, const char *stateFile)
+{
+	RECIPE_PVT *pPvt;
+
+	if(nDevIdx < 0 || nDevIdx >= MAX_SCANDINOVA_CNT || recipeFile == NULL || recipeFile[0] == '\0')
+	{
+		epicsPrintf("scandinovaRecipeConfigure: device 0 ~ %d and a recipe file are required\n",MAX_SCANDINOVA_CNT-1);
+		return -1;
+	}
+	pPvt = &recipePvt[nDevIdx];
+	strncpy(pPvt->recipeFile,recipeFile,sizeof(pPvt->recipeFile)-1);
+	if(stateFile)
+		strncpy(pPvt->stateFile,stateFile,sizeof(pPvt->stateFile)-1);
+	return 0;
+}
+
+// from init_ai, after SDN was cleared; nothing runs without a configured recipe
+int recipeInit(int nDevIdx)
+{
+	RECIPE_PVT *pPvt = &recipePvt[nDevIdx];
+	char thName[64];
+
+	if(pPvt->recipeFile[0] == '\0')
+		return 0;
+	if(loadRecipe(nDevIdx,pPvt->recipeFile) != 0)
+		return -1;
+	restoreState(nDevIdx);
+	if(SDN[nDevIdx].RCP.nState == RCP_STATE_RUN || SDN[nDevIdx].RCP.nState == RCP_STATE_PAUSE)
+		saveMaxPoint(nDevIdx);
+	updateProgress(&SDN[nDevIdx].RCP);
+
+	pPvt->lock = epicsMutexMustCreate();
+	sprintf(thName,"RECIPE#%d",nDevIdx);
+	pPvt->thread = scandinovaThreadCreate(SDN_THREAD_RECIPE,thName,epicsThreadPriorityMedium,epicsThreadStackSmall,
+			(EPICSTHREADFUNC)runRecipeThreadFunc,(void*)(size_t)nDevIdx);
+	return 0;
+}
+
+int recipeCommand(int nDevIdx, int nCmd)
+{
+	RECIPE_PVT *pPvt = &recipePvt[nDevIdx];
+	SCANDINOVA_RECIPE_INFO *pRcp = &SDN[nDevIdx].RCP;
+
+	if(pPvt->thread == NULL)
+		return -1;
+
+	epicsMutexMustLock(pPvt->lock);
+	switch(nCmd)
+	{
+		case RCP_CMD_STOP:
+			pRcp->nState = RCP_STATE_IDLE;
+			pRcp->nStep = 0;
+			pRcp->dbDwellDone = 0;
+			pRcp->nBackoffs = 0;
+			pRcp->bBackedOff = 0;
+			restoreMaxPoint(nDevIdx);
+			break;
+		case RCP_CMD_RUN:
+			if(pRcp->nState == RCP_STATE_DONE)
+				break;
+			saveMaxPoint(nDevIdx);
+			pRcp->nState = RCP_STATE_RUN;
+			pRcp->bApplied = 0;			// setpoints may have been changed by hand meanwhile
+			break;
+		case RCP_CMD_PAUSE:
+			if(pRcp->nState == RCP_STATE_RUN)
+				pRcp->nState = RCP_STATE_PAUSE;
+			break;
+	}
+	updateProgress(pRcp);
+	saveState(nDevIdx);
+	epicsMutexUnlock(pPvt->lock);
+	return 0;
+}
+
+/* iocsh: scandinovaRecipeConfigure(dev, recipeFile, stateFile) */
+static const iocshArg scandinovaRecipeConfigureArg0 = {"dev", iocshArgInt};
+static const iocshArg scandinovaRecipeConfigureArg1 = {"recipeFile", iocshArgString};
+static const iocshArg scandinovaRecipeConfigureArg2 = {"stateFile", iocshArgString};
+static const iocshArg * const scandinovaRecipeConfigureArgs[] = {
+	&scandinovaRecipeConfigureArg0, &scandinovaRecipeConfigureArg1, &scandinovaRecipeConfigureArg2};
+static const iocshFuncDef scandinovaRecipeConfigureDef = {"scandinovaRecipeConfigure", 3, scandinovaRecipeConfigureArgs};
+
+static void scandinovaRecipeConfigureCall(const iocshArgBuf *args)
+{
+	scandinovaRecipeConfigure(args[0].ival, args[1].sval, args[2].sval);
+}
+
+static void scandinovaRecipeRegister(void)
+{
+	iocshRegister(&scandinovaRecipeConfigureDef, scandinovaRecipeConfigureCall);
+}
+epicsExportRegistrar(scandinovaRecipeRegister);
@@ -0,0 +1,62 @@
+/*
+ * SCANDINOVA conditioning recipe step logic
+ *
+ * One evaluation of the running step on fresh data. No EPICS dependency,
+ * recipe.c calls it once per second with the setpoints of the step already
+ * written, scandinovaTest directly. The caller logs and saves the state on
+ * every event and writes the setpoints of a new step (bApplied == 0).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "devSCANDINOVA.h"
+
+#define RECIPE_HV_TOLERANCE		5.0		// read back within this of the target (unit: v)
+
+int recipeEvaluate(SCANDINOVA_RECIPE_INFO *pRcp, double dbVacuum, double dbArc, double dbHvRead, double dbDt)
+{
+	const SCANDINOVA_RECIPE_STEP *pStep;
+
+	if(pRcp->nStep >= pRcp->nStepCount)
+	{
+		pRcp->nState = RCP_STATE_DONE;
+		return RCP_EVENT_DONE;
+	}
+	pStep = &pRcp->pSteps[pRcp->nStep];
+
+	// one back off per excursion, armed again below the advance gate
+	if(pRcp->bBackedOff)
+	{
+		if(dbVacuum < pStep->dbVacAdvance && dbArc < pStep->dbArcAdvance)
+			pRcp->bBackedOff = 0;
+	}
+	else if(dbVacuum >= pStep->dbVacBackoff || dbArc >= pStep->dbArcBackoff)
+	{
+		if(pRcp->nStep > 0)
+			--pRcp->nStep;
+		pRcp->dbDwellDone = 0;
+		pRcp->bApplied = 0;
+		pRcp->bBackedOff = 1;
+		++pRcp->nBackoffs;
+		return RCP_EVENT_BACKOFF;
+	}
+
+	if(fabs(dbHvRead - pStep->dbHv) <= RECIPE_HV_TOLERANCE
+			&& dbVacuum < pStep->dbVacAdvance && dbArc < pStep->dbArcAdvance)
+		pRcp->dbDwellDone += dbDt;
+	if(pRcp->dbDwellDone < pStep->dbDwell)
+		return RCP_EVENT_NONE;
+
+	++pRcp->nStep;
+	pRcp->dbDwellDone = 0;
+	pRcp->bApplied = 0;
+	if(pRcp->nStep >= pRcp->nStepCount)
+	{
+		pRcp->nState = RCP_STATE_DONE;
+		return RCP_EVENT_DONE;
+	}
+	return RCP_EVENT_ADVANCE;
+}
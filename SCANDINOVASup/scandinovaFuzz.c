@@ -0,0 +1,70 @@
+/*
+ * Fuzz entry point of the SCANDINOVA ping frame parser
+ *
+ * libFuzzer:
+ *   clang -g -fsanitize=fuzzer,address -DSDN_LIBFUZZER -I. \
+ *       scandinovaFuzz.c pingParse.c -o scandinovaFuzz
+ *   ./scandinovaFuzz corpus/
+ *
+ * AFL (and plain replay of a crash file), the frame is read from the file
+ * argument or stdin:
+ *   afl-clang-fast -I. scandinovaFuzz.c pingParse.c -o scandinovaFuzz
+ *   afl-fuzz -i corpus -o findings -- ./scandinovaFuzz @@
+ *
+ * The first input byte selects the page, the rest is the frame as it comes
+ * off the port. Every page is parsed the same way the device support does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "devSCANDINOVA.h"
+
+#define FUZZ_MAX_FRAME		4096
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	SCANDINOVA_INFO info;
+	char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN];
+	char strPrefix[16];
+	const char *frame;
+	int nPage;
+	int nCnt;
+
+	if(size < 1)
+		return 0;
+	nPage = data[0] % MAX_SCANDINOVA_PAGE_COUNT;
+	frame = (const char *)data + 1;
+	--size;
+
+	// the exact input, no terminating null, so reads past the frame are caught
+	memset(&info,0,sizeof(info));
+	sprintf(strPrefix,"{p|%03d",nPage);
+	nCnt = scandinovaSplitPing(frame,size,strPrefix,result);
+	if(nCnt > 0)
+		scandinovaStorePing(&info,nPage,result,nCnt);
+	scandinovaParsePing(&info,nPage,frame,size);
+	return 0;
+}
+
+#ifndef SDN_LIBFUZZER
+int main(int argc, char *argv[])
+{
+	static uint8_t data[FUZZ_MAX_FRAME];
+	FILE *fp = stdin;
+	size_t size;
+
+	if(argc > 1 && (fp = fopen(argv[1],"rb")) == NULL)
+	{
+		fprintf(stderr,"scandinovaFuzz: cannot read %s\n",argv[1]);
+		return 1;
+	}
+	size = fread(data,1,sizeof(data),fp);
+	if(fp != stdin)
+		fclose(fp);
+
+	return LLVMFuzzerTestOneInput(data,size);
+}
+#endif
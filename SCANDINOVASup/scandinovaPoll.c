@@ -0,0 +1,249 @@
+/*
+ * SCANDINOVA poll scheduler (DTYP "SCANDINOVA Poll")
+ *
+ * SCAN1FAN of every modulator used to be on the shared "1 second" scan
+ * thread, so all pings of an IOC went out in one burst. The POLL_TICK bi
+ * record of a modulator (SCAN "I/O Intr", FLNK SCAN1FAN) is now processed by
+ * one scheduler thread at its own slot: slot = start + phase + n * period.
+ * The phases spread the modulators evenly over the period unless set, the
+ * pings of each modulator are queued on its own asyn port from the callback
+ * threads and the ports answer in parallel.
+ *
+ *   field(INP, "@<dev>")
+ *
+ *   scandinovaPollConfigure(dev, period, phase)    before iocInit, or the
+ *   AO_POLL_PERIOD / AO_POLL_PHASE records at run time. phase < 0: even spread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <alarm.h>
+#include <dbDefs.h>
+#include <dbAccess.h>
+#include <dbScan.h>
+#include <recGbl.h>
+#include <devSup.h>
+#include <link.h>
+#include <epicsTime.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsStdio.h>
+#include <errlog.h>
+#include <iocsh.h>
+#include <epicsExport.h>
+#include <biRecord.h>
+
+#include "devSCANDINOVA.h"
+#include "scandinovaThread.h"
+
+#define POLL_MAX_WAIT			1.0		// scheduler wakeup without a due slot (unit: sec)
+
+typedef struct
+{
+	int bSet;						// 0: SDN_POLL_PERIOD, even spread
+	double dbPeriod;
+	double dbPhase;
+} POLL_CONFIG;
+
+// scandinovaPollConfigure runs before init_ai clears SDN, applied in init_record
+static POLL_CONFIG pollConfig[MAX_SCANDINOVA_CNT];
+static IOSCANPVT pollScan[MAX_SCANDINOVA_CNT];
+static epicsMutexId pollLock;
+static epicsEventId pollWake;
+static epicsThreadId pollThread;
+static double dbPollStart;
+
+static double pollGetTime(void)
+{
+	epicsTimeStamp tNow;
+	epicsTimeGetCurrent(&tNow);
+	return tNow.secPastEpoch + tNow.nsec * 1e-9;
+}
+
+// slot offsets of all scheduled modulators (pollSlot.c)
+static void placeSlots(double dbNow)
+{
+	SCANDINOVA_POLL_INFO *pList[MAX_SCANDINOVA_CNT];
+	int nDevIdx;
+
+	for(nDevIdx=0;nDevIdx!=MAX_SCANDINOVA_CNT;++nDevIdx)
+		pList[nDevIdx] = &SDN[nDevIdx].POL;
+	scandinovaPollPlace(pList, MAX_SCANDINOVA_CNT, dbPollStart, dbNow);
+}
+
+static void firePoll(int nDevIdx, double dbNow)
+{
+	scandinovaPollFire(&SDN[nDevIdx].POL, dbNow);
+	scanIoRequest(pollScan[nDevIdx]);
+}
+
+static void pollThreadFunc(void *lParam)
+{
+	SCANDINOVA_POLL_INFO *pPoll;
+	double dbNow;
+	double dbWait;
+	int nDevIdx;
+
+	while(1)
+	{
+		epicsMutexMustLock(pollLock);
+		dbNow = pollGetTime();
+		dbWait = POLL_MAX_WAIT;
+		for(nDevIdx=0;nDevIdx!=MAX_SCANDINOVA_CNT;++nDevIdx)
+		{
+			pPoll = &SDN[nDevIdx].POL;
+			if(pPoll->bUse == 0)
+				continue;
+			if(pPoll->dbNext <= dbNow)
+				firePoll(nDevIdx, dbNow);
+			dbWait = fmin(dbWait, pPoll->dbNext - dbNow);
+		}
+		epicsMutexUnlock(pollLock);
+
+		if(dbWait > 0)
+			epicsEventWaitWithTimeout(pollWake, dbWait);
+	}
+}
+
+// from pageDecoded, port thread
+void scandinovaPollDecoded(int nDevIdx, int nPage, double dbTime)
+{
+	if(pollLock == NULL)
+		return;
+	epicsMutexMustLock(pollLock);
+	scandinovaPollAnswer(&SDN[nDevIdx].POL, nPage, dbTime);
+	epicsMutexUnlock(pollLock);
+}
+
+double scandinovaPollPeriod(int nDevIdx)
+{
+	return SDN[nDevIdx].POL.bUse ? SDN[nDevIdx].POL.dbPeriod : SDN_POLL_PERIOD;
+}
+
+int scandinovaPollConfigure(int nDevIdx, double dbPeriod, double dbPhase)
+{
+	if(nDevIdx < 0 || nDevIdx >= MAX_SCANDINOVA_CNT || dbPeriod < 0)
+	{
+		epicsPrintf("scandinovaPollConfigure: bad device %d or period %g\n",nDevIdx,dbPeriod);
+		return -1;
+	}
+	if(dbPeriod == 0)
+		dbPeriod = SDN_POLL_PERIOD;
+
+	pollConfig[nDevIdx].bSet = 1;
+	pollConfig[nDevIdx].dbPeriod = dbPeriod;
+	pollConfig[nDevIdx].dbPhase = dbPhase;
+	if(pollThread == NULL)
+		return 0;
+
+	// running: new slots from now on
+	epicsMutexMustLock(pollLock);
+	SDN[nDevIdx].POL.dbPeriod = dbPeriod;
+	SDN[nDevIdx].POL.dbPhase = dbPhase;
+	placeSlots(pollGetTime());
+	epicsMutexUnlock(pollLock);
+	epicsEventSignal(pollWake);
+	return 0;
+}
+
+static long initPoll(int pass)
+{
+	int nDevIdx;
+
+	if(pass == 0)
+	{
+		pollLock = epicsMutexMustCreate();
+		pollWake = epicsEventMustCreate(epicsEventEmpty);
+		for(nDevIdx=0;nDevIdx!=MAX_SCANDINOVA_CNT;++nDevIdx)
+			scanIoInit(&pollScan[nDevIdx]);
+		return 0;
+	}
+
+	// after the records, before the scan tasks start
+	for(nDevIdx=0;nDevIdx!=MAX_SCANDINOVA_CNT;++nDevIdx)
+	{
+		if(SDN[nDevIdx].POL.bUse)
+			break;
+	}
+	if(nDevIdx == MAX_SCANDINOVA_CNT || pollThread != NULL)
+		return 0;
+
+	dbPollStart = ceil(pollGetTime());
+	placeSlots(dbPollStart);
+	pollThread = scandinovaThreadCreate(SDN_THREAD_POLLER,"SDNPOLL",epicsThreadPriorityHigh,epicsThreadStackSmall,
+			(EPICSTHREADFUNC)pollThreadFunc,NULL);
+	return 0;
+}
+
+static long initBiRecord(struct biRecord *prec)
+{
+	int nDevIdx;
+
+	if(prec->inp.type != INST_IO || sscanf(prec->inp.value.instio.string,"%d",&nDevIdx) != 1
+			|| nDevIdx < 0 || nDevIdx >= MAX_SCANDINOVA_CNT)
+	{
+		recGblRecordError(S_db_badField,(void *)prec,"devSCANDINOVAPoll: INP must be \"@<dev>\"");
+		return S_db_badField;
+	}
+	prec->dpvt = &SDN[nDevIdx];
+	SDN[nDevIdx].POL.bUse = 1;
+	SDN[nDevIdx].POL.dbPeriod = pollConfig[nDevIdx].bSet ? pollConfig[nDevIdx].dbPeriod : SDN_POLL_PERIOD;
+	SDN[nDevIdx].POL.dbPhase = pollConfig[nDevIdx].bSet ? pollConfig[nDevIdx].dbPhase : -1;
+	return 0;
+}
+
+static long getIoIntInfo(int cmd, struct biRecord *prec, IOSCANPVT *ppvt)
+{
+	SCANDINOVA_INFO *pInfo = (SCANDINOVA_INFO *)prec->dpvt;
+
+	if(pInfo == NULL)
+		return -1;
+	*ppvt = pollScan[pInfo->nDevIdx];
+	return 0;
+}
+
+// toggles on every slot, SCAN1FAN follows through FLNK
+static long readBi(struct biRecord *prec)
+{
+	prec->val = prec->val ? 0 : 1;
+	prec->udf = FALSE;
+	return 2;
+}
+
+typedef struct
+{
+	long number;
+	DEVSUPFUN report;
+	DEVSUPFUN init;
+	DEVSUPFUN init_record;
+	DEVSUPFUN get_ioint_info;
+	DEVSUPFUN read;
+} POLL_DSET;
+
+POLL_DSET devBiSCANDINOVAPoll = {
+	5, NULL, (DEVSUPFUN)initPoll, (DEVSUPFUN)initBiRecord, (DEVSUPFUN)getIoIntInfo, (DEVSUPFUN)readBi
+};
+epicsExportAddress(dset, devBiSCANDINOVAPoll);
+
+/* iocsh: scandinovaPollConfigure(dev, period, phase) */
+static const iocshArg scandinovaPollConfigureArg0 = {"dev", iocshArgInt};
+static const iocshArg scandinovaPollConfigureArg1 = {"period", iocshArgDouble};
+static const iocshArg scandinovaPollConfigureArg2 = {"phase", iocshArgDouble};
+static const iocshArg * const scandinovaPollConfigureArgs[] = {
+	&scandinovaPollConfigureArg0, &scandinovaPollConfigureArg1, &scandinovaPollConfigureArg2};
+static const iocshFuncDef scandinovaPollConfigureDef = {"scandinovaPollConfigure", 3, scandinovaPollConfigureArgs};
+
+static void scandinovaPollConfigureCall(const iocshArgBuf *args)
+{
+	scandinovaPollConfigure(args[0].ival, args[1].dval, args[2].dval);
+}
+
+static void scandinovaPollRegister(void)
+{
+	iocshRegister(&scandinovaPollConfigureDef, scandinovaPollConfigureCall);
+}
+epicsExportRegistrar(scandinovaPollRegister);
@@ -0,0 +1,169 @@
+/*
+ * SCANDINOVA shared memory live state export (writer side)
+ *
+ * scandinovaShmConfigure("/name") creates the segment described in
+ * scandinovaShm.h; afterwards every decoded ping frame is published with
+ * its receive time. Without the command nothing is exported.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <osiUnistd.h>
+#include <epicsStdio.h>
+#include <errlog.h>
+#include <epicsTime.h>
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include "devSCANDINOVA.h"
+
+#if defined(_POSIX_SHARED_MEMORY_OBJECTS) && _POSIX_SHARED_MEMORY_OBJECTS > 0
+
+#include "scandinovaShm.h"
+
+static SCANDINOVA_SHM_HEADER *pShm = NULL;
+
+int scandinovaShmConfigure(const char *name)
+{
+	size_t nSize = SCANDINOVA_SHM_SIZE(MAX_SCANDINOVA_CNT);
+	void *pMem;
+	int fd;
+
+	if(pShm)
+	{
+		epicsPrintf("scandinovaShmConfigure: already configured\n");
+		return -1;
+	}
+	if(name == NULL || name[0] != '/')
+	{
+		epicsPrintf("scandinovaShmConfigure: name must start with '/'\n");
+		return -1;
+	}
+
+	fd = shm_open(name, O_CREAT|O_RDWR, 0644);
+	if(fd < 0 || ftruncate(fd, nSize) != 0)
+	{
+		epicsPrintf("scandinovaShmConfigure: %s: %s\n", name, strerror(errno));
+		if(fd >= 0)
+			close(fd);
+		return -1;
+	}
+	pMem = mmap(NULL, nSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(pMem == MAP_FAILED)
+	{
+		epicsPrintf("scandinovaShmConfigure: mmap %s: %s\n", name, strerror(errno));
+		return -1;
+	}
+
+	memset(pMem, 0x00, nSize);
+	((SCANDINOVA_SHM_HEADER*)pMem)->nDevCount = MAX_SCANDINOVA_CNT;
+	((SCANDINOVA_SHM_HEADER*)pMem)->nDevSize = sizeof(SCANDINOVA_SHM_DEVICE);
+	((SCANDINOVA_SHM_HEADER*)pMem)->nVersion = SCANDINOVA_SHM_VERSION;
+	SCANDINOVA_SHM_BARRIER();
+	((SCANDINOVA_SHM_HEADER*)pMem)->nMagic = SCANDINOVA_SHM_MAGIC;
+	pShm = (SCANDINOVA_SHM_HEADER*)pMem;
+	return 0;
+}
+
+// called from the port thread of the device after a page was decoded, ptRecv: receive time of the frame
+void scandinovaShmPublish(int nDevIdx, int nPage, const epicsTimeStamp *ptRecv)
+{
+	SCANDINOVA_SHM_DEVICE *pDev;
+	SCANDINOVA_SHM_DATA *pData;
+	SCANDINOVA_INFO *pInfo = &SDN[nDevIdx];
+	struct timespec ts;
+
+	if(pShm == NULL)
+		return;
+
+	epicsTimeToTimespec(&ts, ptRecv);
+
+	pDev = &pShm->dev[nDevIdx];
+	pData = &pDev->data;
+	scandinovaShmWriteBegin(pDev);
+
+	pDev->nPage = nPage;
+	pDev->nFrame++;
+	pDev->dbTimestamp = ts.tv_sec + ts.tv_nsec * 1e-9;
+	if(nPage >= 0 && nPage < SCANDINOVA_SHM_PAGE_COUNT)
+		pDev->dbPageTime[nPage] = pDev->dbTimestamp;
+
+	switch(nPage)
+	{
+		case 0:
+			pData->dbStateSet = pInfo->dbStateSet;
+			pData->dbStateRead = pInfo->dbStateRead;
+			pData->dbFilamentVoltRead = pInfo->dbFilamentVoltRead;
+			pData->dbFilamentCurrRead = pInfo->dbFilamentCurrRead;
+			pData->dbCtRead = pInfo->dbCtRead;
+			pData->dbCvdRead = pInfo->dbCvdRead;
+			pData->dbCtArcPerSecondRead = pInfo->dbCtArcPerSecondRead;
+			pData->dbCvdArcPerSecondRead = pInfo->dbCvdArcPerSecondRead;
+			pData->dbPrfRead = pInfo->dbPrfRead;
+			pData->dbPlswthRead = pInfo->dbPlswthRead;
+			pData->dbPowRead = pInfo->dbPowRead;
+			pData->dbHVPSVoltRead = pInfo->dbHVPSVoltRead;
+			pData->dbHVPSVoltSet = pInfo->dbHVPSVoltSet;
+			pData->dbPlswthSet = pInfo->dbPlswthSet;
+			pData->dbPrfSet = pInfo->dbPrfSet;
+			pData->dbRemainingTime = pInfo->dbRemainingTime;
+			pData->dbAccessLevel = pInfo->dbAccessLevel;
+			break;
+		case 1:
+			pData->dbSolonoidPs1VoltRead = pInfo->dbSolonoidPs1VoltRead;
+			pData->dbSolonoidPs1CurrRead = pInfo->dbSolonoidPs1CurrRead;
+			pData->dbSolonoidPs1CurrSet = pInfo->dbSolonoidPs1CurrSet;
+			pData->dbSolonoidPs2VoltRead = pInfo->dbSolonoidPs2VoltRead;
+			pData->dbSolonoidPs2CurrRead = pInfo->dbSolonoidPs2CurrRead;
+			pData->dbSolonoidPs3VoltRead = pInfo->dbSolonoidPs3VoltRead;
+			pData->dbSolonoidPs3CurrRead = pInfo->dbSolonoidPs3CurrRead;
+			pData->dbSolonoidPs4VoltRead = pInfo->dbSolonoidPs4VoltRead;
+			pData->dbPresRead1 = pInfo->dbPresRead1;
+			break;
+		case 2:
+			pData->dbStandByCurrSet = pInfo->dbStandByCurrSet;
+			pData->dbSolonoidPs2CurrSet = pInfo->dbSolonoidPs2CurrSet;
+			pData->dbControlWordSet = pInfo->dbControlWordSet;
+			pData->dbSolonoidPs3CurrSet = pInfo->dbSolonoidPs3CurrSet;
+			pData->dbSolonoidPs4CurrSet = pInfo->dbSolonoidPs4CurrSet;
+			pData->dbSolonoidPs2CurrHighLimit = pInfo->dbSolonoidPs2CurrHighLimit;
+			pData->dbSolonoidPs2CurrLowLimit = pInfo->dbSolonoidPs2CurrLowLimit;
+			break;
+	}
+
+	scandinovaShmWriteEnd(pDev);
+}
+
+#else
+
+int scandinovaShmConfigure(const char *name)
+{
+	epicsPrintf("scandinovaShmConfigure: no POSIX shared memory on this target\n");
+	return -1;
+}
+
+void scandinovaShmPublish(int nDevIdx, int nPage, const epicsTimeStamp *ptRecv)
+{
+}
+
+#endif
+
+/* iocsh: scandinovaShmConfigure(name) */
+static const iocshArg scandinovaShmConfigureArg0 = {"name", iocshArgString};
+static const iocshArg * const scandinovaShmConfigureArgs[] = {&scandinovaShmConfigureArg0};
+static const iocshFuncDef scandinovaShmConfigureDef = {"scandinovaShmConfigure", 1, scandinovaShmConfigureArgs};
+
+static void scandinovaShmConfigureCall(const iocshArgBuf *args)
+{
+	scandinovaShmConfigure(args[0].sval);
+}
+
+static void scandinovaShmRegister(void)
+{
+	iocshRegister(&scandinovaShmConfigureDef, scandinovaShmConfigureCall);
+}
+epicsExportRegistrar(scandinovaShmRegister);
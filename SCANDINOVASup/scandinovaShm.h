@@ -0,0 +1,181 @@
+/*
+ * SCANDINOVA shared memory live state (header only, no EPICS needed)
+ *
+ * The IOC publishes the decoded ping values of every modulator into a POSIX
+ * shared memory segment (scandinovaShmConfigure). Each device slot is a
+ * seqlock: nSeq is odd while the IOC writes, a reader copies the slot and
+ * retries when nSeq changed meanwhile. nFrame counts published frames, so a
+ * consumer polling faster than the ping rate sees every frame exactly once.
+ *
+ *   SCANDINOVA_SHM_HEADER *pShm = scandinovaShmAttach("/scandinova");
+ *   SCANDINOVA_SHM_DEVICE dev;
+ *   if(pShm && scandinovaShmRead(pShm, 0, &dev) == 0) ... dev.data.dbHVPSVoltRead
+ */
+
+#ifndef SCANDINOVASHM_H
+#define SCANDINOVASHM_H
+
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SCANDINOVA_SHM_MAGIC			0x53444E56	/* "SDNV" */
+#define SCANDINOVA_SHM_VERSION			1
+#define SCANDINOVA_SHM_PAGE_COUNT		4
+
+#if defined(__GNUC__)
+#define SCANDINOVA_SHM_BARRIER()		__sync_synchronize()
+#else
+#error "scandinovaShm.h: no memory barrier for this compiler"
+#endif
+
+typedef struct
+{
+	/* ping 0 */
+	double dbStateSet;
+	double dbStateRead;
+	double dbFilamentVoltRead;
+	double dbFilamentCurrRead;
+	double dbCtRead;
+	double dbCvdRead;
+	double dbCtArcPerSecondRead;
+	double dbCvdArcPerSecondRead;
+	double dbPrfRead;
+	double dbPlswthRead;
+	double dbPowRead;
+	double dbHVPSVoltRead;
+	double dbHVPSVoltSet;
+	double dbPlswthSet;
+	double dbPrfSet;
+	double dbRemainingTime;
+	double dbAccessLevel;
+
+	/* ping 1 */
+	double dbSolonoidPs1VoltRead;
+	double dbSolonoidPs1CurrRead;
+	double dbSolonoidPs1CurrSet;
+	double dbSolonoidPs2VoltRead;
+	double dbSolonoidPs2CurrRead;
+	double dbSolonoidPs3VoltRead;
+	double dbSolonoidPs3CurrRead;
+	double dbSolonoidPs4VoltRead;
+	double dbPresRead1;
+
+	/* ping 2 */
+	double dbStandByCurrSet;
+	double dbSolonoidPs2CurrSet;
+	double dbControlWordSet;
+	double dbSolonoidPs3CurrSet;
+	double dbSolonoidPs4CurrSet;
+	double dbSolonoidPs2CurrHighLimit;
+	double dbSolonoidPs2CurrLowLimit;
+} SCANDINOVA_SHM_DATA;
+
+typedef struct
+{
+	volatile uint32_t nSeq;			/* odd: update in progress */
+	uint32_t nPage;					/* page of the last frame */
+	uint64_t nFrame;				/* frames published since IOC start */
+	double dbTimestamp;				/* receive time of the last frame (posix sec) */
+	double dbPageTime[SCANDINOVA_SHM_PAGE_COUNT];
+	SCANDINOVA_SHM_DATA data;
+} SCANDINOVA_SHM_DEVICE;
+
+typedef struct
+{
+	uint32_t nMagic;
+	uint32_t nVersion;
+	uint32_t nDevCount;
+	uint32_t nDevSize;				/* sizeof(SCANDINOVA_SHM_DEVICE) of the writer */
+	SCANDINOVA_SHM_DEVICE dev[1];	/* nDevCount entries */
+} SCANDINOVA_SHM_HEADER;
+
+#define SCANDINOVA_SHM_SIZE(nDev) \
+	(offsetof(SCANDINOVA_SHM_HEADER, dev) + (size_t)(nDev) * sizeof(SCANDINOVA_SHM_DEVICE))
+
+/* map a segment read-only, NULL if it does not exist or does not match */
+static inline SCANDINOVA_SHM_HEADER *scandinovaShmAttach(const char *name)
+{
+	SCANDINOVA_SHM_HEADER *pShm;
+	struct stat st;
+	int fd;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if(fd < 0)
+		return NULL;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < SCANDINOVA_SHM_SIZE(1))
+	{
+		close(fd);
+		return NULL;
+	}
+	pShm = (SCANDINOVA_SHM_HEADER*)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(pShm == (SCANDINOVA_SHM_HEADER*)MAP_FAILED)
+		return NULL;
+	if(pShm->nMagic != SCANDINOVA_SHM_MAGIC || pShm->nVersion != SCANDINOVA_SHM_VERSION
+			|| pShm->nDevSize != sizeof(SCANDINOVA_SHM_DEVICE)
+			|| (size_t)st.st_size < SCANDINOVA_SHM_SIZE(pShm->nDevCount))
+	{
+		munmap((void*)pShm, st.st_size);
+		return NULL;
+	}
+	return pShm;
+}
+
+/* consistent snapshot of one device: 0 on success, -1 on bad index */
+static inline int scandinovaShmRead(const SCANDINOVA_SHM_HEADER *pShm, unsigned nDevIdx, SCANDINOVA_SHM_DEVICE *pOut)
+{
+	const SCANDINOVA_SHM_DEVICE *pDev;
+	uint32_t nSeq;
+
+	if(nDevIdx >= pShm->nDevCount)
+		return -1;
+	pDev = &pShm->dev[nDevIdx];
+	do
+	{
+		while((nSeq = pDev->nSeq) & 1)
+			;
+		SCANDINOVA_SHM_BARRIER();
+		memcpy(pOut, (const void*)pDev, sizeof(SCANDINOVA_SHM_DEVICE));
+		SCANDINOVA_SHM_BARRIER();
+	} while(pDev->nSeq != nSeq);
+	pOut->nSeq = nSeq;
+	return 0;
+}
+
+/* frame counter without copying the slot */
+static inline uint64_t scandinovaShmFrame(const SCANDINOVA_SHM_HEADER *pShm, unsigned nDevIdx)
+{
+	const SCANDINOVA_SHM_DEVICE *pDev = &pShm->dev[nDevIdx];
+	uint64_t nFrame;
+	uint32_t nSeq;
+
+	do
+	{
+		while((nSeq = pDev->nSeq) & 1)
+			;
+		SCANDINOVA_SHM_BARRIER();
+		nFrame = pDev->nFrame;
+		SCANDINOVA_SHM_BARRIER();
+	} while(pDev->nSeq != nSeq);
+	return nFrame;
+}
+
+/* writer side, used by the IOC */
+static inline void scandinovaShmWriteBegin(SCANDINOVA_SHM_DEVICE *pDev)
+{
+	pDev->nSeq++;
+	SCANDINOVA_SHM_BARRIER();
+}
+
+static inline void scandinovaShmWriteEnd(SCANDINOVA_SHM_DEVICE *pDev)
+{
+	SCANDINOVA_SHM_BARRIER();
+	pDev->nSeq++;
+}
+
+#endif
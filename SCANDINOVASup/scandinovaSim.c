@@ -0,0 +1,507 @@
+/*
+ * SCANDINOVA auto drive simulator
+ *
+ * Runs the auto drive algorithm (autoDrive.c) against a modulator/vacuum
+ * model in virtual time. The vacuum comes either from a synthetic
+ * conditioning model or from a recorded trace (CSV: time[s],vacuum).
+ * Parameter sweeps are spread over worker threads.
+ *
+ * usage: scandinovaSim [-t trace.csv] [-d hours] [-j threads] [-r seed]
+ *                      [-p name=value] [-m name=value]
+ *                      [-s name=start:stop:step] [-o prefix] [-i interval]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#include <osiUnistd.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+
+#include "devSCANDINOVA.h"
+
+#define SIM_MAX_SWEEP		8
+#define SIM_SUBSTEPS		10
+
+#define MODE_HV_ON			0x0D000
+#define MODE_STANDBY		0x0A000
+#define MODE_READY			0x06000
+#define MODE_FAULT			0x0F000
+
+typedef struct
+{
+	double dbHVInit;			// initial hvps setpoint (v)
+	double dbHVTau;				// hvps readback time constant (sec)
+	double dbVacBase;			// vacuum gauge base value
+	double dbPumpTau;			// outgassing pump down time constant (sec)
+	double dbStepGas;			// outgassing per volt of hv step
+	double dbArcRate;			// arcs per second at the conditioned voltage
+	double dbArcGas;			// outgassing per arc
+	double dbCondInit;			// initially conditioned voltage (v)
+	double dbCondRate;			// conditioning speed (v/sec)
+	double dbCondScale;			// arc/outgassing growth above conditioned voltage (v)
+	double dbHwTripLevel;		// modulator h/w vacuum interlock
+} SIM_MODEL;
+
+typedef struct
+{
+	int nParam;					// index into autoDriveParams
+	double dbStart;
+	double dbStop;
+	double dbStep;
+	int nCount;
+} SIM_SWEEP;
+
+typedef struct
+{
+	int nRun;
+	SCANDINOVA_AUTO_DRIVE_INFO sadi;
+	SIM_MODEL model;
+	SCANDINOVA_INFO info;
+	double dbSweepVal[SIM_MAX_SWEEP];
+
+	// model state
+	double dbTime;
+	double dbGas;
+	double dbCond;
+	int nMode;
+	unsigned long long nRand;
+
+	// results
+	int nTrips;
+	int nHwTrips;
+	int nAlarms;
+	int nSteps;
+	double dbTimeToMax;
+	double dbMaxHv;
+	FILE *fp;
+} SIM_RUN;
+
+static const SCANDINOVA_PARAM_DEF modelParams[] = {
+	{"HVInit",				offsetof(SIM_MODEL,dbHVInit),	0},
+	{"HVTau",				offsetof(SIM_MODEL,dbHVTau),	0},
+	{"VacBase",				offsetof(SIM_MODEL,dbVacBase),	0},
+	{"PumpTau",				offsetof(SIM_MODEL,dbPumpTau),	0},
+	{"StepGas",				offsetof(SIM_MODEL,dbStepGas),	0},
+	{"ArcRate",				offsetof(SIM_MODEL,dbArcRate),	0},
+	{"ArcGas",				offsetof(SIM_MODEL,dbArcGas),	0},
+	{"CondInit",			offsetof(SIM_MODEL,dbCondInit),	0},
+	{"CondRate",			offsetof(SIM_MODEL,dbCondRate),	0},
+	{"CondScale",			offsetof(SIM_MODEL,dbCondScale),	0},
+	{"HwTripLevel",			offsetof(SIM_MODEL,dbHwTripLevel),	0},
+	{NULL, 0, 0}
+};
+
+// shared configuration, read-only once the workers run
+static SCANDINOVA_AUTO_DRIVE_INFO baseSadi;
+static SIM_MODEL baseModel;
+static SIM_SWEEP sweeps[SIM_MAX_SWEEP];
+static int nSweeps = 0;
+static double dbDuration = 72 * 3600.0;
+static double dbInterval = 10.0;
+static unsigned long long nSeed = 1;
+static const char *outPrefix = NULL;
+static double *traceTime = NULL;
+static double *traceVac = NULL;
+static int nTrace = 0;
+
+static SIM_RUN *runs;
+static int nRuns;
+static int nNextRun = 0;
+static int nWorkersLeft;
+static epicsMutexId runLock;
+static epicsEventId doneEvent;
+
+/******************************************************************************
+ * Model
+ *****************************************************************************/
+static double simRandom(SIM_RUN *r)
+{
+	// xorshift64*
+	r->nRand ^= r->nRand >> 12;
+	r->nRand ^= r->nRand << 25;
+	r->nRand ^= r->nRand >> 27;
+	return ((r->nRand * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double traceVacuum(double dbTime)
+{
+	int lo = 0, hi = nTrace - 1, mid;
+
+	if(dbTime <= traceTime[0])
+		return traceVac[0];
+	if(dbTime >= traceTime[hi])
+		return traceVac[hi];
+	while(hi - lo > 1)
+	{
+		mid = (lo + hi) / 2;
+		if(traceTime[mid] <= dbTime)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return traceVac[lo] + (traceVac[hi] - traceVac[lo])
+		* (dbTime - traceTime[lo]) / (traceTime[hi] - traceTime[lo]);
+}
+
+static void stepModel(SIM_RUN *r, double dt)
+{
+	SIM_MODEL *m = &r->model;
+	SCANDINOVA_INFO *pInfo = &r->info;
+	double dbTarget;
+	double dbExcess;
+
+	dbTarget = (r->nMode == MODE_HV_ON) ? pInfo->dbHVPSVoltSet : 0.0;
+	pInfo->dbHVPSVoltRead += (dbTarget - pInfo->dbHVPSVoltRead) * (1.0 - exp(-dt / m->dbHVTau));
+
+	r->dbGas *= exp(-dt / m->dbPumpTau);
+	if(r->nMode == MODE_HV_ON)
+	{
+		dbExcess = (pInfo->dbHVPSVoltRead - r->dbCond) / m->dbCondScale;
+		if(simRandom(r) < m->dbArcRate * exp(dbExcess) * dt)
+		{
+			r->dbGas += m->dbArcGas;
+			pInfo->dbCtArcPerSecondRead += 1;
+		}
+		if(pInfo->dbHVPSVoltRead >= r->dbCond - m->dbCondScale)
+			r->dbCond += m->dbCondRate * dt;
+	}
+
+	if(nTrace > 0)
+		pInfo->dbSolonoidPs2CurrRead = traceVacuum(r->dbTime);
+	else
+		pInfo->dbSolonoidPs2CurrRead = m->dbVacBase + r->dbGas;
+
+	if(r->nMode != MODE_FAULT && pInfo->dbSolonoidPs2CurrRead >= m->dbHwTripLevel)
+	{
+		r->nMode = MODE_FAULT;
+		++r->nHwTrips;
+	}
+	pInfo->dbStateRead = r->nMode;
+}
+
+/******************************************************************************
+ * Auto drive clock/actuator interface of the simulator
+ *****************************************************************************/
+static double simGetTime(void *pPvt)
+{
+	return ((SIM_RUN*)pPvt)->dbTime;
+}
+static SCANDINOVA_INFO *simGetInfo(void *pPvt, int nDevIdx)
+{
+	return &((SIM_RUN*)pPvt)->info;
+}
+static int simChangeMode(void *pPvt, int nDevIdx, int nMode)
+{
+	SIM_RUN *r = (SIM_RUN*)pPvt;
+
+	if(nMode == MODE_STANDBY && r->nMode == MODE_HV_ON)
+		++r->nTrips;
+	if(r->nMode != MODE_FAULT)
+		r->nMode = nMode;
+	return 1;
+}
+static int simSetHv(void *pPvt, int nDevIdx, double dbSetpoint)
+{
+	SIM_RUN *r = (SIM_RUN*)pPvt;
+	double dbStep = dbSetpoint - r->info.dbHVPSVoltSet;
+
+	if(dbStep > 0 && r->nMode == MODE_HV_ON)
+	{
+		r->dbGas += r->model.dbStepGas * dbStep
+			* exp((dbSetpoint - r->dbCond) / r->model.dbCondScale);
+		++r->nSteps;
+	}
+	r->info.dbHVPSVoltSet = dbSetpoint;
+	return 1;
+}
+static int simHwControlSet(void *pPvt, int nDevIdx, int nMode)
+{
+	SIM_RUN *r = (SIM_RUN*)pPvt;
+
+	if((nMode & 0x0001) && r->nMode == MODE_FAULT)
+		r->nMode = MODE_READY;
+	return 1;
+}
+
+static const SCANDINOVA_AUTO_DRIVE_OPS simOpsTemplate = {
+	simGetTime, simGetInfo, simChangeMode, simSetHv, simHwControlSet, NULL, NULL
+};
+
+static void runSimulation(SIM_RUN *r)
+{
+	SCANDINOVA_AUTO_DRIVE_OPS ops = simOpsTemplate;
+	SCANDINOVA_AD_SAMPLE smp;
+	double dbNextSample = 0;
+	int nPrevState;
+	int i;
+
+	ops.pPvt = r;
+	r->dbCond = r->model.dbCondInit;
+	r->nMode = MODE_HV_ON;
+	r->nRand = nSeed ? nSeed : 1;
+	r->info.dbHVPSVoltSet = r->model.dbHVInit;
+	r->info.dbHVPSVoltRead = r->model.dbHVInit;
+	r->info.dbSolonoidPs2CurrRead = r->model.dbVacBase;
+	r->info.dbStateRead = r->nMode;
+	r->sadi.dbVacuum = &r->info.dbSolonoidPs2CurrRead;
+	r->info.bReady = 1;
+	r->dbTimeToMax = -1;
+	autoDriveStart(&r->sadi, &ops);
+
+	while(r->dbTime < dbDuration)
+	{
+		r->info.dbCtArcPerSecondRead = 0;
+		for(i=0;i!=SIM_SUBSTEPS;++i)
+		{
+			r->dbTime += 1.0 / SIM_SUBSTEPS;
+			stepModel(r, 1.0 / SIM_SUBSTEPS);
+		}
+		r->info.dbPageTime[0] = r->dbTime;		// every ping answered
+		r->info.dbPageTime[1] = r->dbTime;
+		autoDriveTakeSample(&r->sadi, &r->info, r->dbTime, &smp);
+		autoDriveSample(&r->sadi, &smp);
+		nPrevState = r->sadi.nState;
+		autoDriveProcess(&r->sadi, &ops);
+		if(r->sadi.nState == AD_STATE_ALARM_DECREASE && nPrevState != AD_STATE_ALARM_DECREASE)
+			++r->nAlarms;
+
+		if(r->info.dbHVPSVoltRead > r->dbMaxHv)
+			r->dbMaxHv = r->info.dbHVPSVoltRead;
+		if(r->dbTimeToMax < 0 && r->info.dbHVPSVoltRead >= r->sadi.dbHVMaxPoint - 2)
+			r->dbTimeToMax = r->dbTime;
+
+		if(r->fp && r->dbTime >= dbNextSample)
+		{
+			fprintf(r->fp,"%.1f,%.4f,%.2f,%.2f,%X,%d\n",r->dbTime,r->info.dbSolonoidPs2CurrRead,
+					r->info.dbHVPSVoltSet,r->info.dbHVPSVoltRead,r->nMode,r->sadi.nState);
+			dbNextSample += dbInterval;
+		}
+	}
+}
+
+static void simWorker(void *lParam)
+{
+	SIM_RUN *r;
+	char fileName[512];
+
+	while(1)
+	{
+		epicsMutexMustLock(runLock);
+		r = nNextRun < nRuns ? &runs[nNextRun++] : NULL;
+		epicsMutexUnlock(runLock);
+		if(r == NULL)
+			break;
+
+		if(outPrefix)
+		{
+			sprintf(fileName,"%s_%04d.csv",outPrefix,r->nRun);
+			r->fp = fopen(fileName,"w");
+			if(r->fp)
+				fprintf(r->fp,"time,vacuum,hvset,hvread,mode,adstate\n");
+		}
+		runSimulation(r);
+		if(r->fp)
+			fclose(r->fp);
+	}
+
+	epicsMutexMustLock(runLock);
+	if(--nWorkersLeft == 0)
+		epicsEventSignal(doneEvent);
+	epicsMutexUnlock(runLock);
+}
+
+/******************************************************************************
+ * Command line
+ *****************************************************************************/
+static int setParam(const SCANDINOVA_PARAM_DEF *table, void *pBase, const char *arg)
+{
+	const char *eq = strchr(arg,'=');
+	int n;
+
+	if(eq == NULL || (n = autoDriveFindParam(table,arg,eq-arg)) < 0)
+		return -1;
+	autoDriveSetParam(&table[n],pBase,atof(eq+1));
+	return 0;
+}
+
+static int addSweep(const char *arg)
+{
+	const char *eq = strchr(arg,'=');
+	SIM_SWEEP *s = &sweeps[nSweeps];
+
+	if(nSweeps == SIM_MAX_SWEEP || eq == NULL
+			|| (s->nParam = autoDriveFindParam(autoDriveParams,arg,eq-arg)) < 0
+			|| sscanf(eq+1,"%lf:%lf:%lf",&s->dbStart,&s->dbStop,&s->dbStep) != 3
+			|| s->dbStep <= 0 || s->dbStop < s->dbStart)
+		return -1;
+	s->nCount = (int)floor((s->dbStop - s->dbStart) / s->dbStep + 1e-9) + 1;
+	++nSweeps;
+	return 0;
+}
+
+static int loadTrace(const char *fileName)
+{
+	FILE *fp = fopen(fileName,"r");
+	char line[256];
+	int nAlloc = 0;
+	double t,v;
+
+	if(fp == NULL)
+		return -1;
+	while(fgets(line,sizeof line,fp))
+	{
+		if(sscanf(line,"%lf,%lf",&t,&v) != 2)
+			continue;	// header or comment
+		if(nTrace == nAlloc)
+		{
+			nAlloc = nAlloc ? nAlloc*2 : 4096;
+			traceTime = (double*)realloc(traceTime,nAlloc*sizeof(double));
+			traceVac = (double*)realloc(traceVac,nAlloc*sizeof(double));
+		}
+		traceTime[nTrace] = t;
+		traceVac[nTrace] = v;
+		++nTrace;
+	}
+	fclose(fp);
+	return nTrace > 0 ? 0 : -1;
+}
+
+static void usage(void)
+{
+	int i;
+	fprintf(stderr,"usage: scandinovaSim [-t trace.csv] [-d hours] [-j threads] [-r seed]\n"
+			"                     [-p name=value] [-m name=value] [-s name=start:stop:step]\n"
+			"                     [-o prefix] [-i interval]\n");
+	fprintf(stderr,"auto drive parameters (-p, -s):");
+	for(i=0;autoDriveParams[i].name;++i)
+		fprintf(stderr," %s",autoDriveParams[i].name);
+	fprintf(stderr,"\nmodel parameters (-m):");
+	for(i=0;modelParams[i].name;++i)
+		fprintf(stderr," %s",modelParams[i].name);
+	fprintf(stderr,"\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int nThreads = 1;
+	int bDurationSet = 0;
+	int i,j,n;
+	char thName[64];
+	SIM_RUN *r;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	nThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	autoDriveSetDefaults(&baseSadi,0,0);
+	baseModel.dbHVInit = 800.0;
+	baseModel.dbHVTau = 1.0;
+	baseModel.dbVacBase = 3.2;
+	baseModel.dbPumpTau = 60.0;
+	baseModel.dbStepGas = 0.02;
+	baseModel.dbArcRate = 1e-4;
+	baseModel.dbArcGas = 0.6;
+	baseModel.dbCondInit = 1000.0;		// conditioned through the fixed fast ramp below 1000v
+	baseModel.dbCondRate = 0.02;
+	baseModel.dbCondScale = 15.0;
+	baseModel.dbHwTripLevel = 5.8;
+
+	for(i=1;i<argc;++i)
+	{
+		if(argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' || i+1 == argc)
+		{
+			usage();
+			return 1;
+		}
+		switch(argv[i++][1])
+		{
+			case 't':
+				if(loadTrace(argv[i]) != 0)
+				{
+					fprintf(stderr,"scandinovaSim: cannot read trace %s\n",argv[i]);
+					return 1;
+				}
+				break;
+			case 'd':	dbDuration = atof(argv[i]) * 3600.0; bDurationSet = 1; break;
+			case 'j':	nThreads = atoi(argv[i]); break;
+			case 'r':	nSeed = strtoull(argv[i],NULL,0); break;
+			case 'o':	outPrefix = argv[i]; break;
+			case 'i':	dbInterval = atof(argv[i]); break;
+			case 'p':
+				if(setParam(autoDriveParams,&baseSadi,argv[i]) == 0)
+					break;
+				usage();
+				return 1;
+			case 'm':
+				if(setParam(modelParams,&baseModel,argv[i]) == 0)
+					break;
+				usage();
+				return 1;
+			case 's':
+				if(addSweep(argv[i]) == 0)
+					break;
+				usage();
+				return 1;
+			default:
+				usage();
+				return 1;
+		}
+	}
+	if(nTrace > 0 && !bDurationSet)
+		dbDuration = traceTime[nTrace-1];
+
+	nRuns = 1;
+	for(i=0;i!=nSweeps;++i)
+		nRuns *= sweeps[i].nCount;
+	runs = (SIM_RUN*)calloc(nRuns,sizeof(SIM_RUN));
+	if(runs == NULL)
+		return 1;
+	for(n=0;n!=nRuns;++n)
+	{
+		r = &runs[n];
+		r->nRun = n;
+		r->sadi = baseSadi;
+		r->model = baseModel;
+		for(i=0,j=n;i!=nSweeps;++i)
+		{
+			r->dbSweepVal[i] = sweeps[i].dbStart + (j % sweeps[i].nCount) * sweeps[i].dbStep;
+			autoDriveSetParam(&autoDriveParams[sweeps[i].nParam],&r->sadi,r->dbSweepVal[i]);
+			j /= sweeps[i].nCount;
+		}
+	}
+
+	if(nThreads < 1)
+		nThreads = 1;
+	if(nThreads > nRuns)
+		nThreads = nRuns;
+	nWorkersLeft = nThreads;
+	runLock = epicsMutexMustCreate();
+	doneEvent = epicsEventMustCreate(epicsEventEmpty);
+	for(i=0;i!=nThreads;++i)
+	{
+		sprintf(thName,"SIM#%d",i);
+		epicsThreadCreate(thName,epicsThreadPriorityMedium,epicsThreadGetStackSize(epicsThreadStackMedium),
+				(EPICSTHREADFUNC)simWorker,NULL);
+	}
+	epicsEventMustWait(doneEvent);
+
+	printf("run");
+	for(i=0;i!=nSweeps;++i)
+		printf(",%s",autoDriveParams[sweeps[i].nParam].name);
+	printf(",trips,hwtrips,alarms,steps,timetomax,maxhv\n");
+	for(n=0;n!=nRuns;++n)
+	{
+		r = &runs[n];
+		printf("%d",r->nRun);
+		for(i=0;i!=nSweeps;++i)
+			printf(",%g",r->dbSweepVal[i]);
+		printf(",%d,%d,%d,%d,%.0f,%.2f\n",r->nTrips,r->nHwTrips,r->nAlarms,r->nSteps,
+				r->dbTimeToMax,r->dbMaxHv);
+	}
+	return 0;
+}
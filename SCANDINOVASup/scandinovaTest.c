@@ -0,0 +1,793 @@
+/*
+ * SCANDINOVA unit tests (no IOC, no modulator)
+ *
+ * Table driven tests of the ping frame parser and the first fault latch
+ * (pingParse.c), of the command write verification (writeVerify.c), of
+ * the auto drive decisions (autoDrive.c) in every vacuum region, run with a
+ * recording SCANDINOVA_AUTO_DRIVE_OPS on a virtual clock, of the shadow
+ * auto drive (autoDriveShadow.c) on the same samples, of the recipe steps
+ * (recipeEngine.c) on a tick sequence, of the station group grants
+ * (rampGroupRank.c) and of the poll slots (pollSlot.c).
+ *
+ *   make runtests
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "devSCANDINOVA.h"
+
+/******************************************************************************
+ * Frame parser
+ *****************************************************************************/
+typedef struct
+{
+	const char *name;
+	int nPage;
+	const char *frame;
+	int nResult;					// scandinovaParsePing
+} PARSE_CASE;
+
+static const PARSE_CASE parseCases[] = {
+	{"ping 0",				0, "{p|000|D000|A000|5.1|20.5|1.2|3.4|A|B|10|2.5|50.3|1250.5|1250.0|2.5|10|3C|2", 0},
+	{"ping 1",				1, "{p|001|1.0|2.0|3.0|4.0|4.25|6.0|7.0|8.0|9.0", 0},
+	{"ping 2",				2, "{p|002|1.5|0003|5.2|3.5|2.0|3.0|4.0", 0},
+	{"ping 3",				3, "{p|003|0", 0},
+	{"ping 0 extra field",	0, "{p|000|D000|A000|5.1|20.5|1.2|3.4|A|B|10|2.5|50.3|1250.5|1250.0|2.5|10|3C|2|7", 0},
+	{"reply of page 1",		0, "{p|001|D000|A000|5.1|20.5|1.2|3.4|A|B|10|2.5|50.3|1250.5|1250.0|2.5|10|3C|2", -1},
+	{"no prefix",			1, "1.0|2.0|3.0|4.0|4.25|6.0|7.0|8.0|9.0", -1},
+	{"short prefix",		1, "{p|0", -1},
+	{"empty",				2, "", -1},
+	{"ping 0 short",		0, "{p|000|D000|A000|5.1|20.5|1.2|3.4|A|B|10|2.5|50.3|1250.5|1250.0|2.5|10|3C", -1},
+	{"ping 1 short",		1, "{p|001|1.0|2.0|3.0|4.0|4.25|6.0|7.0|8.0", -1},
+	{"ping 2 short",		2, "{p|002|1.5|0003|5.2|3.5|2.0|3.0", -1},
+	{"too many fields",		3, "{p|003|0|1|2|3|4|5|6|7|8|9|10|11|12|13|14|15|16|17|18", -1},
+	{"page out of range",	4, "{p|004|0", -1},
+};
+
+static void testParseTable(void)
+{
+	SCANDINOVA_INFO info;
+	size_t i;
+	int nRet;
+
+	for(i=0;i!=sizeof(parseCases)/sizeof(parseCases[0]);++i)
+	{
+		memset(&info,0,sizeof(info));
+		nRet = scandinovaParsePing(&info,parseCases[i].nPage,parseCases[i].frame,strlen(parseCases[i].frame));
+		testOk(nRet == parseCases[i].nResult,"parse %s: %d",parseCases[i].name,nRet);
+	}
+}
+
+static void testParseValues(void)
+{
+	SCANDINOVA_INFO info;
+
+	memset(&info,0,sizeof(info));
+	scandinovaParsePing(&info,0,parseCases[0].frame,strlen(parseCases[0].frame));
+	testOk1(info.dbStateRead == 0xD000);
+	testOk1(info.dbStateSet == 0xA000);
+	testOk1(info.dbCtArcPerSecondRead == 10 && info.dbCvdArcPerSecondRead == 11);
+	testOk1(info.dbPowRead == 50.3);
+	testOk1(info.dbHVPSVoltRead == 1250.5 && info.dbHVPSVoltSet == 1250.0);
+	testOk1(info.dbRemainingTime == 60 && info.dbAccessLevel == 2);
+
+	scandinovaParsePing(&info,1,parseCases[1].frame,strlen(parseCases[1].frame));
+	testOk1(info.dbSolonoidPs2CurrRead == 4.25);
+	testOk1(info.dbPresRead1 == 9.0);
+
+	scandinovaParsePing(&info,2,parseCases[2].frame,strlen(parseCases[2].frame));
+	testOk1(info.dbControlWordSet == 3);
+	testOk1(info.dbSolonoidPs2CurrHighLimit == 5.2 && info.dbSolonoidPs2CurrLowLimit == 3.5);
+
+	// a rejected frame leaves the stored values alone
+	scandinovaParsePing(&info,0,parseCases[9].frame,strlen(parseCases[9].frame));
+	testOk(info.dbHVPSVoltRead == 1250.5,"short frame not stored");
+}
+
+// field and token count limits, frames built around SDN_MAX_TOKEN / SDN_MAX_TOKEN_LEN
+static void testParseLimits(void)
+{
+	char result[SDN_MAX_TOKEN][SDN_MAX_TOKEN_LEN];
+	char frame[SDN_MAX_TOKEN * SDN_MAX_TOKEN_LEN + 64];
+	int i;
+
+	strcpy(frame,"{p|001|");
+	memset(frame + strlen(frame),'1',SDN_MAX_TOKEN_LEN - 1);
+	frame[7 + SDN_MAX_TOKEN_LEN - 1] = '\0';
+	testOk(scandinovaSplitPing(frame,strlen(frame),"{p|001",result) == 3,"field of %d chars",SDN_MAX_TOKEN_LEN - 1);
+	strcat(frame,"1");
+	testOk(scandinovaSplitPing(frame,strlen(frame),"{p|001",result) == 0,"field of %d chars rejected",SDN_MAX_TOKEN_LEN);
+
+	strcpy(frame,"{p|001");
+	for(i=2;i!=SDN_MAX_TOKEN;++i)
+		strcat(frame,"|0");
+	testOk(scandinovaSplitPing(frame,strlen(frame),"{p|001",result) == SDN_MAX_TOKEN,"%d tokens",SDN_MAX_TOKEN);
+	strcat(frame,"|0");
+	testOk(scandinovaSplitPing(frame,strlen(frame),"{p|001",result) == 0,"%d tokens rejected",SDN_MAX_TOKEN + 1);
+
+	// only nRet bytes are looked at
+	strcpy(frame,"{p|003|0|1");
+	testOk(scandinovaSplitPing(frame,8,"{p|003",result) == 3 && strcmp(result[2],"0") == 0,"length limited frame");
+}
+
+static void testFaultLatch(void)
+{
+	SCANDINOVA_FAULT_INFO fault;
+
+	memset(&fault,0,sizeof(fault));
+	fault.nMask = SDN_FAULT_MASK_DEFAULT;
+	scandinovaFaultReset(&fault);
+
+	scandinovaFaultSample(&fault,0xD000,10.0);
+	scandinovaFaultSample(&fault,0xD000,11.0);
+	testOk(fault.bLatched == 0 && fault.nFirstBit == -1,"first fault: no change");
+
+	scandinovaFaultSample(&fault,0xA000,11.2);
+	scandinovaFaultSample(&fault,0x6000,11.4);
+	scandinovaFaultSample(&fault,0xD000,11.6);
+	testOk(fault.bLatched == 0,"first fault: standby, reset and hv on ignored");
+
+	scandinovaFaultSample(&fault,0xD005,12.0);
+	testOk(fault.bLatched == 1 && fault.nFirstBit == 0 && fault.nChangedMask == 0x0005,"first fault: bits 0x%X",fault.nChangedMask);
+	testOk(fault.nWordBefore == 0xD000 && fault.nWordAfter == 0xD005 && fault.dbTime == 12.0,"first fault: words and time");
+
+	scandinovaFaultSample(&fault,0xF00D,13.0);
+	testOk(fault.nFirstBit == 0 && fault.dbTime == 12.0,"first fault: later changes ignored");
+
+	scandinovaFaultReset(&fault);
+	scandinovaFaultSample(&fault,0x6001,14.0);
+	testOk(fault.bLatched == 0,"first fault: reset, bits clearing ignored");
+	scandinovaFaultSample(&fault,0xF001,15.0);
+	testOk(fault.bLatched == 1 && fault.nFirstBit == 12 && fault.nChangedMask == 0x9000,"first fault: fault mode entry bit %d",fault.nFirstBit);
+
+	fault.nMask = 0x000F;
+	scandinovaFaultReset(&fault);
+	scandinovaFaultSample(&fault,0xF0F1,16.0);
+	testOk(fault.bLatched == 0,"first fault: masked bits ignored, already in fault mode");
+}
+
+/******************************************************************************
+ * Write verification
+ *****************************************************************************/
+static void testWriteVerify(void)
+{
+	SCANDINOVA_INFO info;
+	SCANDINOVA_VERIFY_INFO *pHv = &info.VFY[SDN_VERIFY_HV];
+	SCANDINOVA_VERIFY_INFO *pCw = &info.VFY[SDN_VERIFY_CONTROL];
+
+	memset(&info,0,sizeof(info));
+	info.dbVerifyTimeout = 3;
+	info.nVerifyRetries = 2;
+	info.dbHVPSVoltSet = 1100;
+
+	// applied in the first frame after the write
+	scandinovaVerifyStart(pHv,1101,10.0);
+	testOk(scandinovaVerifyFrame(&info,0,9.9) == 0 && pHv->nStatus == SDN_VERIFY_PENDING,"verify: frame before the write ignored");
+	testOk(scandinovaVerifyFrame(&info,0,11.0) == 0 && pHv->nStatus == SDN_VERIFY_PENDING,"verify: not yet applied");
+	info.dbHVPSVoltSet = 1101.2;
+	testOk(scandinovaVerifyFrame(&info,2,12.0) == 0 && pHv->nStatus == SDN_VERIFY_PENDING,"verify: other page ignored");
+	scandinovaVerifyFrame(&info,0,12.5);
+	testOk(pHv->nStatus == SDN_VERIFY_APPLIED && pHv->nApplied == 1 && fabs(pHv->dbLatency - 2.5) < 1e-9,
+			"verify: applied within the tolerance, latency %.1f sec",pHv->dbLatency);
+
+	// retries, then failed
+	scandinovaVerifyStart(pHv,1110,20.0);
+	testOk(scandinovaVerifyFrame(&info,0,22.0) == 0,"verify: no retry before the timeout");
+	testOk(scandinovaVerifyFrame(&info,0,23.0) == (1 << SDN_VERIFY_HV),"verify: retry after the timeout");
+	scandinovaVerifyRetry(pHv,23.1);
+	testOk(scandinovaVerifyFrame(&info,0,25.0) == 0,"verify: timeout from the retry");
+	testOk(scandinovaVerifyFrame(&info,0,26.2) == (1 << SDN_VERIFY_HV),"verify: second retry");
+	scandinovaVerifyRetry(pHv,26.2);
+	testOk(scandinovaVerifyFrame(&info,0,29.5) == 0 && pHv->nStatus == SDN_VERIFY_FAILED && pHv->nFailed == 1
+			&& pHv->nRetries == 2,"verify: failed after %d retries",pHv->nRetries);
+
+	// latency of a late application counts from the first write
+	scandinovaVerifyStart(pHv,1120,30.0);
+	scandinovaVerifyRetry(pHv,33.0);
+	scandinovaVerifyStart(pHv,1120,33.5);
+	info.dbHVPSVoltSet = 1120;
+	scandinovaVerifyFrame(&info,0,34.0);
+	testOk(pHv->nStatus == SDN_VERIFY_APPLIED && fabs(pHv->dbLatency - 4.0) < 1e-9,"verify: latency from the first write %.1f sec",pHv->dbLatency);
+
+	// self clearing reset bits of the control word are not compared
+	info.dbControlWordSet = 0x0002;
+	scandinovaVerifyStart(pCw,0x0103,40.0);
+	scandinovaVerifyFrame(&info,2,41.0);
+	testOk(pCw->nStatus == SDN_VERIFY_APPLIED,"verify: control word without reset bits");
+
+	scandinovaVerifyReset(pHv);
+	testOk(pHv->nApplied == 0 && pHv->nFailed == 0 && pHv->dbLatencyMax == 0,"verify: counters reset");
+}
+
+/******************************************************************************
+ * Auto drive decisions
+ *****************************************************************************/
+typedef struct
+{
+	double dbNow;
+	SCANDINOVA_INFO info;
+	int nModeCalls;
+	int nLastMode;
+	int nHvCalls;
+	double dbLastHv;
+	int nHwCalls;
+} TEST_OPS_PVT;
+
+static double testGetTime(void *pPvt)
+{
+	return ((TEST_OPS_PVT*)pPvt)->dbNow;
+}
+static SCANDINOVA_INFO *testGetInfo(void *pPvt, int nDevIdx)
+{
+	return &((TEST_OPS_PVT*)pPvt)->info;
+}
+static int testChangeMode(void *pPvt, int nDevIdx, int nMode)
+{
+	TEST_OPS_PVT *t = (TEST_OPS_PVT*)pPvt;
+	++t->nModeCalls;
+	t->nLastMode = nMode;
+	return 1;
+}
+static int testSetHv(void *pPvt, int nDevIdx, double dbSetpoint)
+{
+	TEST_OPS_PVT *t = (TEST_OPS_PVT*)pPvt;
+	++t->nHvCalls;
+	t->dbLastHv = dbSetpoint;
+	return 1;
+}
+static int testHwControlSet(void *pPvt, int nDevIdx, int nMode)
+{
+	++((TEST_OPS_PVT*)pPvt)->nHwCalls;
+	return 1;
+}
+
+typedef struct
+{
+	const char *name;
+	double dbVacuum;
+	int bOnArcing;					// before
+	int bOnAlarm;
+	int nMode;						// expected changeMode, -1: none
+	double dbHv;					// expected setHv, -1: none
+	int nState;						// expected after
+	double dbHold;					// expected hold time (unit: sec)
+	int bOnArcingAfter;
+} AD_CASE;
+
+// defaults: trip high 5.2, alarm high 4.8, alarm low 3.6, trip low 3.5, hv 1100 v
+static const AD_CASE adCases[] = {
+	{"trip high",				5.3,	0, 0, 0xA000,	-1,		AD_STATE_RUN,				0,		1},
+	{"alarm high",				5.0,	0, 0, -1,		1100,	AD_STATE_ALARM_DECREASE,	300,	0},
+	{"normal",					4.0,	0, 0, -1,		1101,	AD_STATE_RUN,				0,		0},
+	{"normal, arcing",			4.0,	1, 0, -1,		-1,		AD_STATE_RUN,				0,		1},
+	{"normal, alarm",			4.0,	0, 1, -1,		-1,		AD_STATE_RUN,				0,		0},
+	{"alarm low",				3.55,	0, 0, -1,		1101,	AD_STATE_RUN,				0,		0},
+	{"alarm low, alarm",		3.55,	0, 1, -1,		-1,		AD_STATE_ALARM_BLOCK,		30,		0},
+	{"trip low",				3.0,	0, 0, -1,		1101,	AD_STATE_RUN,				0,		0},
+	{"trip low, arcing",		3.0,	1, 0, 0xD000,	1101,	AD_STATE_RUN,				0,		0},
+};
+
+static void setupAutoDrive(SCANDINOVA_AUTO_DRIVE_INFO *p, SCANDINOVA_AUTO_DRIVE_OPS *pOps, TEST_OPS_PVT *t)
+{
+	memset(t,0,sizeof(TEST_OPS_PVT));
+	t->dbNow = 1000;
+	t->info.dbStateRead = 0xD000;
+	t->info.dbHVPSVoltRead = 1100;
+	t->info.dbHVPSVoltSet = 1100;
+	t->info.bReady = 1;
+	t->info.dbPageTime[0] = t->dbNow;
+	t->info.dbPageTime[1] = t->dbNow;
+
+	pOps->getTime = testGetTime;
+	pOps->getInfo = testGetInfo;
+	pOps->changeMode = testChangeMode;
+	pOps->setHv = testSetHv;
+	pOps->hwControlSet = testHwControlSet;
+	pOps->grantStep = NULL;
+	pOps->pPvt = t;
+
+	autoDriveSetDefaults(p,0,0);
+	p->dbVacuum = &t->info.dbSolonoidPs2CurrRead;
+	p->bSettleUse = 0;
+	autoDriveStart(p,pOps);
+	autoDriveProcess(p,pOps);			// startup -> run, step timer from startup
+	p->dbLastIncrease = t->dbNow - 100;
+	t->nHvCalls = 0;
+}
+
+static void testAutoDriveRegions(void)
+{
+	SCANDINOVA_AUTO_DRIVE_INFO sadi;
+	SCANDINOVA_AUTO_DRIVE_OPS ops;
+	TEST_OPS_PVT t;
+	const AD_CASE *c;
+	size_t i;
+
+	for(i=0;i!=sizeof(adCases)/sizeof(adCases[0]);++i)
+	{
+		c = &adCases[i];
+		setupAutoDrive(&sadi,&ops,&t);
+		t.info.dbSolonoidPs2CurrRead = c->dbVacuum;
+		sadi.bOnArcing = c->bOnArcing;
+		sadi.bOnAlarm = c->bOnAlarm;
+
+		autoDriveProcess(&sadi,&ops);
+
+		if(c->nMode < 0)
+			testOk(t.nModeCalls == 0,"%s: no mode change",c->name);
+		else
+			testOk(t.nModeCalls == 1 && t.nLastMode == c->nMode,"%s: mode 0x%X",c->name,t.nLastMode);
+		if(c->dbHv < 0)
+			testOk(t.nHvCalls == 0,"%s: no hv change",c->name);
+		else
+			testOk(t.nHvCalls == 1 && fabs(t.dbLastHv - c->dbHv) < 1e-6,"%s: hv %.2f",c->name,t.dbLastHv);
+		testOk(sadi.nState == c->nState,"%s: state %d",c->name,sadi.nState);
+		if(c->dbHold > 0)
+			testOk(fabs(sadi.dbHoldUntil - t.dbNow - c->dbHold) < 1e-6,"%s: hold %.0f sec",c->name,sadi.dbHoldUntil - t.dbNow);
+		testOk(sadi.bOnArcing == c->bOnArcingAfter,"%s: arcing %d",c->name,sadi.bOnArcing);
+	}
+}
+
+static void testAutoDriveGuards(void)
+{
+	SCANDINOVA_AUTO_DRIVE_INFO sadi;
+	SCANDINOVA_AUTO_DRIVE_OPS ops;
+	TEST_OPS_PVT t;
+	SCANDINOVA_FAST_LATCH latch;
+	SCANDINOVA_AD_SAMPLE smp;
+
+	// trip high: mid point is the trip gain of the read back
+	setupAutoDrive(&sadi,&ops,&t);
+	t.info.dbSolonoidPs2CurrRead = 5.3;
+	autoDriveProcess(&sadi,&ops);
+	testOk(sadi.bOnMidPoint == 1 && fabs(sadi.dbMidPoint - 990) < 1e-6,"trip high: mid point %.2f",sadi.dbMidPoint);
+
+	// below 1000 v the step is 10 v, steps stop at the max point
+	setupAutoDrive(&sadi,&ops,&t);
+	t.info.dbSolonoidPs2CurrRead = 4.0;
+	t.info.dbHVPSVoltRead = t.info.dbHVPSVoltSet = 900;
+	autoDriveProcess(&sadi,&ops);
+	testOk(t.nHvCalls == 1 && t.dbLastHv == 910,"below 1000 v: hv %.2f",t.dbLastHv);
+
+	setupAutoDrive(&sadi,&ops,&t);
+	t.info.dbSolonoidPs2CurrRead = 4.0;
+	t.info.dbHVPSVoltRead = t.info.dbHVPSVoltSet = 1289.5;
+	autoDriveProcess(&sadi,&ops);
+	testOk(t.nHvCalls == 0,"max point: no step within the settle tolerance");
+
+	// step timer
+	setupAutoDrive(&sadi,&ops,&t);
+	t.info.dbSolonoidPs2CurrRead = 4.0;
+	sadi.dbLastIncrease = t.dbNow - 10;
+	autoDriveProcess(&sadi,&ops);
+	testOk(t.nHvCalls == 0,"no step before the check time");
+
+	// interlock reset when the modulator is not in trigger
+	setupAutoDrive(&sadi,&ops,&t);
+	t.info.dbSolonoidPs2CurrRead = 4.0;
+	t.info.dbStateRead = 0x6000;
+	autoDriveProcess(&sadi,&ops);
+	testOk(sadi.nState == AD_STATE_RESET_BLOCK && t.nHvCalls == 0,"not in trigger: reset block");
+
+	// stale data freezes the auto drive
+	setupAutoDrive(&sadi,&ops,&t);
+	t.info.dbSolonoidPs2CurrRead = 5.3;
+	t.dbNow += sadi.dbStaleLimit + 1;
+	autoDriveProcess(&sadi,&ops);
+	testOk(sadi.bStale == 1 && t.nModeCalls == 0 && t.nHvCalls == 0,"stale data: no action");
+
+	// disabled channel
+	setupAutoDrive(&sadi,&ops,&t);
+	t.info.dbSolonoidPs2CurrRead = 5.3;
+	sadi.bUse = 0;
+	autoDriveProcess(&sadi,&ops);
+	testOk(t.nModeCalls == 0 && t.nHvCalls == 0,"disabled: no action");
+
+	// fast path reports crossings only, the channel is left to its owner
+	setupAutoDrive(&sadi,&ops,&t);
+	memset(&latch,0,sizeof(latch));
+	t.info.dbSolonoidPs2CurrRead = 5.3;
+	testOk(autoDriveFastCheck(&sadi,&latch) == AD_FAST_TRIP,"fast check: trip crossing");
+	testOk(autoDriveFastCheck(&sadi,&latch) == AD_FAST_NONE,"fast check: trip reported once");
+	testOk(sadi.bOnArcing == 0 && sadi.bFastTrip == 0,"fast check: channel unchanged");
+	t.info.dbSolonoidPs2CurrRead = 4.0;
+	testOk(autoDriveFastCheck(&sadi,&latch) == AD_FAST_NONE,"fast check: normal");
+	t.info.dbSolonoidPs2CurrRead = 5.0;
+	testOk(autoDriveFastCheck(&sadi,&latch) == AD_FAST_ALARM,"fast check: alarm crossing");
+
+	// fast trip: mid point from the hv of the crossing, kept by the slow loop
+	setupAutoDrive(&sadi,&ops,&t);
+	t.info.dbSolonoidPs2CurrRead = 5.3;
+	autoDriveFastTrip(&sadi,1200);
+	t.info.dbHVPSVoltRead = 1000;
+	autoDriveProcess(&sadi,&ops);
+	testOk(sadi.bOnArcing == 1 && fabs(sadi.dbMidPoint - 1080) < 1e-6 && t.nLastMode == 0xA000,
+			"fast trip: mid point %.2f",sadi.dbMidPoint);
+
+	// no step while the last hv write is not applied
+	setupAutoDrive(&sadi,&ops,&t);
+	t.info.dbSolonoidPs2CurrRead = 4.0;
+	t.info.VFY[SDN_VERIFY_HV].nStatus = SDN_VERIFY_PENDING;
+	autoDriveProcess(&sadi,&ops);
+	testOk(t.nHvCalls == 0,"hv write pending: no step");
+	t.info.VFY[SDN_VERIFY_HV].nStatus = SDN_VERIFY_FAILED;
+	autoDriveProcess(&sadi,&ops);
+	testOk(t.nHvCalls == 1,"hv write failed: step again");
+
+	// interlock reset: hv on as soon as the 300 v are applied, not after the hold
+	setupAutoDrive(&sadi,&ops,&t);
+	t.info.dbSolonoidPs2CurrRead = 4.0;
+	sadi.nState = AD_STATE_RESET_WAIT;
+	t.info.dbStateRead = 0x6000;
+	autoDriveProcess(&sadi,&ops);
+	testOk(sadi.nState == AD_STATE_RESET_HV && t.dbLastHv == 300,"reset: 300 v");
+	t.dbNow += 1;
+	autoDriveProcess(&sadi,&ops);
+	testOk(sadi.nState == AD_STATE_RESET_HV && t.nModeCalls == 0,"reset: hold while the 300 v are not applied");
+	t.dbNow += 5;
+	t.info.dbPageTime[0] = t.info.dbPageTime[1] = t.dbNow;
+	t.nHvCalls = 0;
+	autoDriveProcess(&sadi,&ops);
+	testOk(sadi.nState == AD_STATE_RESET_HV && t.nModeCalls == 0 && t.nHvCalls == 1 && t.dbLastHv == 300,
+			"reset: no hv on after the hold, 300 v again");
+	scandinovaVerifyStart(&t.info.VFY[SDN_VERIFY_HV],300,t.dbNow);
+	t.info.VFY[SDN_VERIFY_HV].nStatus = SDN_VERIFY_APPLIED;
+	t.dbNow += 1;
+	autoDriveProcess(&sadi,&ops);
+	testOk(t.nModeCalls == 1 && t.nLastMode == 0xD000,"reset: hv on after the 300 v are applied");
+
+	// settle: samples taken before a step never settle it
+	setupAutoDrive(&sadi,&ops,&t);
+	t.info.dbSolonoidPs2CurrRead = 4.0;
+	autoDriveProcess(&sadi,&ops);
+	smp.dbHvSet = smp.dbHvRead = sadi.dbCommandedHv;
+	smp.dbArc = 0;
+	smp.dbVacuum = 4.0;
+	for(smp.dbTime = t.dbNow - 5; smp.dbTime < t.dbNow; smp.dbTime += 1)
+		autoDriveSample(&sadi,&smp);
+	testOk(sadi.bSettled == 0 && sadi.dbSettleStart < 0,"settle: samples before the step ignored");
+	for(smp.dbTime = t.dbNow; smp.dbTime <= t.dbNow + 3; smp.dbTime += 1)
+		autoDriveSample(&sadi,&smp);
+	testOk(sadi.bSettled == 1,"settle: settled after the window");
+}
+
+/******************************************************************************
+ * Shadow auto drive
+ *****************************************************************************/
+static void shadowTick(SCANDINOVA_SHADOW_INFO *pShd, SCANDINOVA_AUTO_DRIVE_INFO *pSrc, TEST_OPS_PVT *t, int nSeconds)
+{
+	int i;
+
+	for(i=0;i!=nSeconds;++i)
+	{
+		t->info.dbPageTime[0] = t->dbNow;
+		t->info.dbPageTime[1] = t->dbNow;
+		autoDriveShadowProcess(pShd,pSrc,&t->info,t->dbNow);
+		t->dbNow += 1;
+	}
+}
+
+static void testShadow(void)
+{
+	SCANDINOVA_AUTO_DRIVE_INFO sadi;
+	SCANDINOVA_AUTO_DRIVE_OPS ops;
+	TEST_OPS_PVT t;
+	SCANDINOVA_SHADOW_INFO fast;
+	SCANDINOVA_SHADOW_INFO tight;
+
+	memset(&fast,0,sizeof(fast));
+	memset(&tight,0,sizeof(tight));
+	testOk(autoDriveShadowConfigure(&fast,0,"NoSuchParam=1") == -1 && fast.bUse == 0,"shadow: unknown parameter");
+	testOk(autoDriveShadowConfigure(&fast,0,"HVRampSpeed") == -1,"shadow: parameter without value");
+	testOk(autoDriveShadowConfigure(&fast,0,"HVRampSpeed=2x") == -1,"shadow: bad value");
+	testOk(autoDriveShadowConfigure(&fast,MAX_SCANDINOVA_VACUUM_COUNT,"") == -1,"shadow: bad source");
+	testOk(autoDriveShadowConfigure(&fast,0,"HVRampCheckTime=5, SettleUse=0") == 0 && fast.bUse && fast.nParams == 2,
+			"shadow: two overrides");
+
+	// a faster ramp on the live samples, the live channel untouched
+	setupAutoDrive(&sadi,&ops,&t);
+	t.info.dbSolonoidPs2CurrRead = 4.0;
+	autoDriveShadowConfigure(&tight,0,"TripHighLimit=4.5");
+	shadowTick(&fast,&sadi,&t,60);
+	testOk(fast.nSteps == 12 && fabs(fast.dbHvSet - 1112) < 1e-9,"shadow: %d steps to %.1f v in 60 sec",fast.nSteps,fast.dbHvSet);
+	testOk(t.nHvCalls == 0 && t.nModeCalls == 0 && t.info.dbHVPSVoltSet == 1100,"shadow: no live command");
+	testOk(fast.dbTimeToMax > 0 && fast.dbLiveTimeToMax == -1,"shadow: time to max %.0f sec, live not rising",fast.dbTimeToMax);
+
+	// own limits: a trip the live channel does not see, then the blocking hold
+	t.info.dbSolonoidPs2CurrRead = 4.6;
+	shadowTick(&tight,&sadi,&t,1);
+	testOk(tight.nTrips == 1 && tight.nMode == 0xA000,"shadow: trip on its own limit");
+	shadowTick(&tight,&sadi,&t,11);
+	testOk(tight.sadi.nState == AD_STATE_RESET_BLOCK && fabs(tight.dbHoldTime - 10) < 1e-9,
+			"shadow: %.0f sec in the trip blocking hold",tight.dbHoldTime);
+
+	// a hardware fault of the modulator trips every shadow
+	t.info.dbStateRead = 0xF000;
+	shadowTick(&fast,&sadi,&t,1);
+	testOk(fast.nTrips == 1 && fast.nMode == 0xF000,"shadow: live hardware fault");
+}
+
+/******************************************************************************
+ * Recipe steps
+ *****************************************************************************/
+typedef struct
+{
+	const char *name;
+	double dbVacuum;
+	double dbArc;
+	double dbHvRead;
+	int nEvent;						// expected RCP_EVENT_xxx
+	int nStep;						// expected after
+	int nBackoffs;
+} RCP_CASE;
+
+// hv dwell vacAdv arcAdv vacBack arcBack
+static SCANDINOVA_RECIPE_STEP rcpSteps[] = {
+	{900,	-1, -1, 3, 3.6, 0.1, 4.8, 1.0},
+	{950,	-1, -1, 2, 3.6, 0.1, 4.8, 1.0},
+	{1000,	-1, -1, 1, 3.6, 0.1, 4.8, 1.0},
+};
+
+// one tick per second, in order
+static const RCP_CASE rcpCases[] = {
+	{"step 1 dwell",				3.0,	0.0,	900,	RCP_EVENT_NONE,		0, 0},
+	{"step 1 dwell",				3.0,	0.0,	900,	RCP_EVENT_NONE,		0, 0},
+	{"step 1 done",					3.0,	0.0,	900,	RCP_EVENT_ADVANCE,	1, 0},
+	{"step 2 dwell",				3.0,	0.0,	950,	RCP_EVENT_NONE,		1, 0},
+	{"vacuum back off",				5.0,	0.0,	950,	RCP_EVENT_BACKOFF,	0, 1},
+	{"still above, no back off",	5.0,	0.0,	950,	RCP_EVENT_NONE,		0, 1},
+	{"above advance, latched",		4.0,	0.0,	900,	RCP_EVENT_NONE,		0, 1},
+	{"below advance, armed",		3.0,	0.0,	900,	RCP_EVENT_NONE,		0, 1},
+	{"back off on step 1",			5.0,	0.0,	900,	RCP_EVENT_BACKOFF,	0, 2},
+	{"arc above advance, latched",	3.0,	2.0,	900,	RCP_EVENT_NONE,		0, 2},
+	{"step 1 dwell again",			3.0,	0.0,	900,	RCP_EVENT_NONE,		0, 2},
+	{"step 1 dwell again",			3.0,	0.0,	900,	RCP_EVENT_NONE,		0, 2},
+	{"step 1 done again",			3.0,	0.0,	900,	RCP_EVENT_ADVANCE,	1, 2},
+	{"hv off target, no dwell",		3.0,	0.0,	940,	RCP_EVENT_NONE,		1, 2},
+	{"step 2 dwell",				3.0,	0.0,	950,	RCP_EVENT_NONE,		1, 2},
+	{"step 2 done",					3.0,	0.0,	950,	RCP_EVENT_ADVANCE,	2, 2},
+	{"arc back off",				3.0,	1.5,	1000,	RCP_EVENT_BACKOFF,	1, 3},
+	{"armed",						3.0,	0.0,	950,	RCP_EVENT_NONE,		1, 3},
+	{"step 2 done",					3.0,	0.0,	950,	RCP_EVENT_ADVANCE,	2, 3},
+	{"last step done",				3.0,	0.0,	1000,	RCP_EVENT_DONE,		3, 3},
+};
+
+static void testRecipe(void)
+{
+	SCANDINOVA_RECIPE_INFO rcp;
+	const RCP_CASE *c;
+	int nEvent;
+	size_t i;
+
+	memset(&rcp,0,sizeof(rcp));
+	rcp.pSteps = rcpSteps;
+	rcp.nStepCount = sizeof(rcpSteps)/sizeof(rcpSteps[0]);
+	rcp.nState = RCP_STATE_RUN;
+
+	for(i=0;i!=sizeof(rcpCases)/sizeof(rcpCases[0]);++i)
+	{
+		c = &rcpCases[i];
+		nEvent = recipeEvaluate(&rcp,c->dbVacuum,c->dbArc,c->dbHvRead,1.0);
+		testOk(nEvent == c->nEvent && rcp.nStep == c->nStep && rcp.nBackoffs == c->nBackoffs,
+				"recipe tick %d, %s: event %d, step %d, back offs %d",(int)i+1,c->name,nEvent,rcp.nStep+1,rcp.nBackoffs);
+	}
+	testOk(rcp.nState == RCP_STATE_DONE,"recipe: done");
+}
+
+/******************************************************************************
+ * Station group grants
+ *****************************************************************************/
+#define RANK_REQ_CNT	3
+
+typedef struct
+{
+	double dbHeadroom;
+	int nOrder;
+	double dbFrom;
+	double dbTo;
+	double dbPowRead;
+} RANK_REQ;
+
+typedef struct
+{
+	const char *name;
+	double dbPowerBudget;			// 0: unlimited
+	double dbDvBudget;
+	double dbDvLeft;
+	double dbGroupPower;
+	int nReq;
+	RANK_REQ req[RANK_REQ_CNT];
+	const char *szGranted;			// expected per request, '1': granted
+	int nRank[RANK_REQ_CNT];		// expected per request
+	double dbDvLeftAfter;
+} RANK_CASE;
+
+// a 1000 -> 1100 V step at 100 kW predicts 26.9 kW more
+static const RANK_CASE rankCases[] = {
+	{"unlimited budgets, headroom order",	0,   0,  0,  200,	3,
+		{{0.2, 0, 1000, 1010, 100}, {0.9, 1, 1000, 1010, 100}, {0.5, 2, 1000, 1010, 100}},	"111", {3, 1, 2}, 0},
+	{"equal headroom, request order",		0,   0,  0,  200,	3,
+		{{0.5, 2, 1000, 1010, 100}, {0.5, 0, 1000, 1010, 100}, {0.5, 1, 1000, 1010, 100}},	"111", {3, 1, 2}, 0},
+	{"power budget defers",					240, 0,  0,  200,	3,
+		{{0.9, 0, 1000, 1100, 100}, {0.8, 1, 1000, 1100, 100}, {0.7, 2, 1000, 1100, 0}},	"101", {1, 2, 3}, 0},
+	{"hv budget defers",					0,   30, 25, 200,	3,
+		{{0.9, 0, 1000, 1010, 100}, {0.8, 1, 1000, 1010, 100}, {0.7, 2, 1000, 1010, 100}},	"110", {1, 2, 3}, 5},
+	{"deferred step, next one fits",		0,   30, 10, 200,	2,
+		{{0.9, 0, 1000, 1020, 100}, {0.5, 1, 1000, 1005, 100}},								"01",  {1, 2},    5},
+	{"oversize step, budget not full",		0,   30, 29, 200,	1,
+		{{0.9, 0, 1000, 1040, 100}},														"0",   {1},       29},
+	{"oversize step, budget full",			0,   30, 30, 200,	1,
+		{{0.9, 0, 1000, 1040, 100}},														"1",   {1},       0},
+};
+
+static void testRampGroupRank(void)
+{
+	SCANDINOVA_RAMP_REQUEST req[RANK_REQ_CNT];
+	SCANDINOVA_RAMP_REQUEST *pList[RANK_REQ_CNT];
+	SCANDINOVA_SCHED_INFO sch;
+	const RANK_CASE *c;
+	char szGranted[RANK_REQ_CNT + 1];
+	int bRank;
+	int nGrants;
+	int nExpect;
+	int i;
+	size_t k;
+
+	for(k=0;k!=sizeof(rankCases)/sizeof(rankCases[0]);++k)
+	{
+		c = &rankCases[k];
+		memset(req,0,sizeof(req));
+		memset(&sch,0,sizeof(sch));
+		sch.dbPowerBudget = c->dbPowerBudget;
+		sch.dbDvBudget = c->dbDvBudget;
+		sch.dbDvLeft = c->dbDvLeft;
+		sch.dbGroupPower = c->dbGroupPower;
+		for(i=0;i!=c->nReq;++i)
+		{
+			req[i].nIdx = i;
+			req[i].nOrder = c->req[i].nOrder;
+			req[i].bPending = 1;
+			req[i].dbHeadroom = c->req[i].dbHeadroom;
+			req[i].dbFrom = c->req[i].dbFrom;
+			req[i].dbTo = c->req[i].dbTo;
+			req[i].dbPowRead = c->req[i].dbPowRead;
+			pList[i] = &req[i];
+		}
+
+		nGrants = rampGroupRank(pList,c->nReq,&sch,100.0);
+
+		bRank = 1;
+		nExpect = 0;
+		for(i=0;i!=c->nReq;++i)
+		{
+			szGranted[i] = req[i].bGranted ? '1' : '0';
+			nExpect += c->szGranted[i] == '1';
+			bRank = bRank && req[i].nRank == c->nRank[i] && req[i].bPending == 0;
+		}
+		szGranted[c->nReq] = '\0';
+		testOk(strcmp(szGranted,c->szGranted) == 0 && nGrants == nExpect && bRank
+				&& fabs(sch.dbDvLeft - c->dbDvLeftAfter) < 1e-9,
+				"rank %s: granted %s, hv left %.1f",c->name,szGranted,sch.dbDvLeft);
+	}
+
+	memset(req,0,sizeof(req));
+	req[0].dbFrom = 1000;
+	req[0].dbTo = 1100;
+	req[0].dbPowRead = 100;
+	testOk(fabs(rampGroupPredictPower(&req[0]) - 100 * (pow(1.1, 2.5) - 1)) < 1e-9,"rank: power rise of a step");
+	req[0].dbTo = 900;
+	testOk(rampGroupPredictPower(&req[0]) == 0,"rank: no power rise of a decrease");
+}
+
+/******************************************************************************
+ * Poll slots
+ *****************************************************************************/
+#define SLOT_DEV_CNT	4
+
+typedef struct
+{
+	const char *name;
+	double dbAt;					// fire time after the start
+	int nAnswer;					// pings decoded before the next slot: 0, 1 (ping 0) or 4
+	int nOverruns;					// expected after the fire
+	int nNoReply;
+	int nMissed;
+} SLOT_CASE;
+
+// one modulator at a 1 sec period, in order
+static const SLOT_CASE slotCases[] = {
+	{"first slot",					0.0,	4,	0, 0, 0},
+	{"answered and done",			1.0,	1,	0, 0, 0},
+	{"answered, not done",			2.0,	0,	1, 0, 0},
+	{"no answer",					3.0,	0,	1, 1, 0},
+	{"no answer again",				4.0,	4,	1, 2, 0},
+	{"woke two periods late",		7.2,	4,	1, 2, 2},
+	{"back on the slot",			8.0,	4,	1, 2, 0},
+};
+
+static void testPollSlots(void)
+{
+	SCANDINOVA_POLL_INFO poll[SLOT_DEV_CNT];
+	SCANDINOVA_POLL_INFO *pList[SLOT_DEV_CNT];
+	SCANDINOVA_POLL_INFO *p = &poll[0];
+	const SLOT_CASE *c;
+	double dbStart = 1000.0;
+	int nMissed = 0;
+	int i;
+	size_t k;
+
+	memset(poll,0,sizeof(poll));
+	for(i=0;i!=SLOT_DEV_CNT;++i)
+	{
+		poll[i].bUse = i != 2;
+		poll[i].dbPeriod = 1.0;
+		poll[i].dbPhase = -1;
+		pList[i] = &poll[i];
+	}
+	poll[3].dbPhase = 2.25;
+
+	scandinovaPollPlace(pList,SLOT_DEV_CNT,dbStart,dbStart);
+	testOk(poll[0].dbPhaseUsed == 0 && poll[1].dbPhaseUsed == 1.0 / 3 && poll[3].dbPhaseUsed == 0.25,
+			"poll: even spread of the unset phases, set phase modulo the period");
+	testOk(poll[0].dbNext == dbStart && poll[3].dbNext == dbStart + 0.25 && poll[2].dbNext == 0,
+			"poll: first slots from the start, unused modulator left alone");
+	scandinovaPollPlace(pList,SLOT_DEV_CNT,dbStart,dbStart + 5.5);
+	testOk(poll[0].dbNext == dbStart + 6 && poll[3].dbNext == dbStart + 6.25 && poll[1].dbPhaseUsed == 1.0 / 3,
+			"poll: placed again later, next slots on the same phases");
+
+	scandinovaPollPlace(pList,SLOT_DEV_CNT,dbStart,dbStart);
+	for(k=0;k!=sizeof(slotCases)/sizeof(slotCases[0]);++k)
+	{
+		c = &slotCases[k];
+		nMissed = p->nMissed;
+		scandinovaPollFire(p,dbStart + c->dbAt);
+		testOk(p->nOverruns == c->nOverruns && p->nNoReply == c->nNoReply && p->nMissed - nMissed == c->nMissed
+				&& p->dbNext == dbStart + floor(c->dbAt) + 1 && p->nPolls == (int)k + 1,
+				"poll slot %d, %s: overruns %d, no reply %d, missed %d",(int)k+1,c->name,p->nOverruns,p->nNoReply,p->nMissed - nMissed);
+		if(c->nAnswer > 0)
+			scandinovaPollAnswer(p,0,dbStart + c->dbAt + 0.05);
+		if(c->nAnswer > 1)
+			scandinovaPollAnswer(p,MAX_SCANDINOVA_PAGE_COUNT - 1,dbStart + c->dbAt + 0.2);
+	}
+	testOk(fabs(p->dbLatency - 0.2) < 1e-9 && p->bDone,"poll: latency of the last slot");
+	scandinovaPollAnswer(p,MAX_SCANDINOVA_PAGE_COUNT - 1,p->dbFired - 0.5);
+	testOk(fabs(p->dbLatency - 0.2) < 1e-9,"poll: answer older than the slot ignored");
+}
+
+MAIN(scandinovaTest)
+{
+	testPlan(0);
+
+	testDiag("frame parser");
+	testParseTable();
+	testParseValues();
+	testParseLimits();
+	testFaultLatch();
+
+	testDiag("write verification");
+	testWriteVerify();
+
+	testDiag("auto drive");
+	testAutoDriveRegions();
+	testAutoDriveGuards();
+
+	testDiag("shadow auto drive");
+	testShadow();
+
+	testDiag("recipe");
+	testRecipe();
+
+	testDiag("station group");
+	testRampGroupRank();
+
+	testDiag("poll scheduler");
+	testPollSlots();
+
+	return testDone();
+}
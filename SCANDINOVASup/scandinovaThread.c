@@ -0,0 +1,194 @@
+/*
+ * SCANDINOVA worker thread placement and wakeup jitter (see scandinovaThread.h)
+ *
+ *   scandinovaThreadConfigure(name, priority, stackSize, cpus)
+ *
+ * name is a thread class (autoDrive, slew, group, recipe, poller), applied
+ * to the threads of that class created afterwards, or the name of a running
+ * thread (asyn port threads are named after their port), changed right away.
+ * priority is an EPICS priority 1 ~ 99, stackSize in bytes, cpus a list
+ * like "2" or "0,2-3". 0 and "" keep the default.
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <epicsStdio.h>
+#include <errlog.h>
+#include <epicsThread.h>
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include "scandinovaThread.h"
+
+#define SDN_THREAD_MAX_CPUS_LEN		64
+
+typedef struct
+{
+	const char *strName;
+	unsigned int nPriority;			// 0: default of the thread
+	unsigned int nStackSize;		// 0: default of the thread (unit: byte)
+	char strCpus[SDN_THREAD_MAX_CPUS_LEN];	// "": no affinity
+} THREAD_CLASS_CONFIG;
+
+static THREAD_CLASS_CONFIG classConfig[SDN_THREAD_CLASS_COUNT] = {
+	{"autoDrive"}, {"slew"}, {"group"}, {"recipe"}, {"poller"}
+};
+
+#ifdef __linux__
+static int setAffinity(epicsThreadId id, const char *strName, const char *strCpus)
+{
+	cpu_set_t cpus;
+	const char *p = strCpus;
+	char *end;
+	long nFirst,nLast,n;
+
+	CPU_ZERO(&cpus);
+	while(*p)
+	{
+		nFirst = strtol(p,&end,10);
+		if(end == p || nFirst < 0 || nFirst >= CPU_SETSIZE)
+			break;
+		nLast = nFirst;
+		p = end;
+		if(*p == '-')
+		{
+			nLast = strtol(p+1,&end,10);
+			if(end == p+1 || nLast < nFirst || nLast >= CPU_SETSIZE)
+				break;
+			p = end;
+		}
+		for(n=nFirst;n<=nLast;++n)
+			CPU_SET(n,&cpus);
+		if(*p == ',')
+			++p;
+		else if(*p)
+			break;
+	}
+	if(*p || CPU_COUNT(&cpus) == 0)
+	{
+		epicsPrintf("scandinovaThread: bad cpu list \"%s\" for %s\n",strCpus,strName);
+		return -1;
+	}
+	if(pthread_setaffinity_np(epicsThreadGetPosixThreadId(id),sizeof(cpus),&cpus) != 0)
+	{
+		epicsPrintf("scandinovaThread: cannot set the affinity of %s to %s\n",strName,strCpus);
+		return -1;
+	}
+	return 0;
+}
+#else
+static int setAffinity(epicsThreadId id, const char *strName, const char *strCpus)
+{
+	epicsPrintf("scandinovaThread: no cpu affinity on this target, %s not pinned\n",strName);
+	return -1;
+}
+#endif
+
+epicsThreadId scandinovaThreadCreate(int nClass, const char *strName, unsigned int nPriority,
+		epicsThreadStackSizeClass stackSize, EPICSTHREADFUNC func, void *pParm)
+{
+	THREAD_CLASS_CONFIG *pCfg = &classConfig[nClass];
+	epicsThreadId id;
+
+	id = epicsThreadCreate(strName,
+			pCfg->nPriority ? pCfg->nPriority : nPriority,
+			pCfg->nStackSize ? pCfg->nStackSize : epicsThreadGetStackSize(stackSize),
+			func,pParm);
+	if(id != NULL && pCfg->strCpus[0])
+		setAffinity(id,strName,pCfg->strCpus);
+	return id;
+}
+
+int scandinovaThreadConfigure(const char *strName, int nPriority, int nStackSize, const char *strCpus)
+{
+	epicsThreadId id;
+	int i;
+
+	if(strName == NULL || strName[0] == '\0')
+	{
+		epicsPrintf("scandinovaThreadConfigure: thread class or thread name missing\n");
+		return -1;
+	}
+	if(nPriority < 0 || nPriority > epicsThreadPriorityMax || nStackSize < 0)
+	{
+		epicsPrintf("scandinovaThreadConfigure: bad priority %d or stack size %d\n",nPriority,nStackSize);
+		return -1;
+	}
+	if(strCpus == NULL)
+		strCpus = "";
+	if(strlen(strCpus) >= SDN_THREAD_MAX_CPUS_LEN)
+	{
+		epicsPrintf("scandinovaThreadConfigure: cpu list too long\n");
+		return -1;
+	}
+
+	for(i=0;i!=SDN_THREAD_CLASS_COUNT;++i)
+	{
+		if(strcmp(strName,classConfig[i].strName) == 0)
+		{
+			classConfig[i].nPriority = nPriority;
+			classConfig[i].nStackSize = nStackSize;
+			strcpy(classConfig[i].strCpus,strCpus);
+			return 0;
+		}
+	}
+
+	// a running thread, the stack cannot change any more
+	if((id = epicsThreadGetId(strName)) == NULL)
+	{
+		epicsPrintf("scandinovaThreadConfigure: %s is no thread class or running thread\n",strName);
+		return -1;
+	}
+	if(nStackSize > 0)
+		epicsPrintf("scandinovaThreadConfigure: %s is running, stack size ignored\n",strName);
+	if(nPriority > 0)
+		epicsThreadSetPriority(id,nPriority);
+	if(strCpus[0])
+		return setAffinity(id,strName,strCpus);
+	return 0;
+}
+
+void scandinovaJitterSample(SCANDINOVA_JITTER_INFO *pJitter, double dbScheduled, double dbActual)
+{
+	pJitter->dbLast = dbActual - dbScheduled;
+	pJitter->dbMax = fmax(pJitter->dbMax, fabs(pJitter->dbLast));
+	pJitter->dbSum += fabs(pJitter->dbLast);
+	++pJitter->nWakeups;
+}
+
+void scandinovaJitterReset(SCANDINOVA_JITTER_INFO *pJitter)
+{
+	pJitter->nWakeups = 0;
+	pJitter->dbLast = 0;
+	pJitter->dbMax = 0;
+	pJitter->dbSum = 0;
+}
+
+/* iocsh: scandinovaThreadConfigure(name, priority, stackSize, cpus) */
+static const iocshArg scandinovaThreadConfigureArg0 = {"name", iocshArgString};
+static const iocshArg scandinovaThreadConfigureArg1 = {"priority", iocshArgInt};
+static const iocshArg scandinovaThreadConfigureArg2 = {"stackSize", iocshArgInt};
+static const iocshArg scandinovaThreadConfigureArg3 = {"cpus", iocshArgString};
+static const iocshArg * const scandinovaThreadConfigureArgs[] = {
+	&scandinovaThreadConfigureArg0, &scandinovaThreadConfigureArg1, &scandinovaThreadConfigureArg2, &scandinovaThreadConfigureArg3};
+static const iocshFuncDef scandinovaThreadConfigureDef = {"scandinovaThreadConfigure", 4, scandinovaThreadConfigureArgs};
+
+static void scandinovaThreadConfigureCall(const iocshArgBuf *args)
+{
+	scandinovaThreadConfigure(args[0].sval, args[1].ival, args[2].ival, args[3].sval);
+}
+
+static void scandinovaThreadRegister(void)
+{
+	iocshRegister(&scandinovaThreadConfigureDef, scandinovaThreadConfigureCall);
+}
+epicsExportRegistrar(scandinovaThreadRegister);
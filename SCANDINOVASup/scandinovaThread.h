@@ -0,0 +1,50 @@
+/*
+ * SCANDINOVA worker thread placement and wakeup jitter
+ *
+ * Every worker of the support is created through scandinovaThreadCreate with
+ * the priority and stack size it always had. scandinovaThreadConfigure (iocsh,
+ * before iocInit) overrides the priority, stack size and CPU affinity of a
+ * thread class, or changes a running thread such as an asyn port thread:
+ *
+ *   scandinovaThreadConfigure("autoDrive", 90, 0, "2")
+ *   scandinovaThreadConfigure("L0", 85, 0, "2-3")
+ */
+
+#ifndef SCANDINOVATHREAD_H
+#define SCANDINOVATHREAD_H
+
+#include <epicsThread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// thread classes of scandinovaThreadConfigure
+#define SDN_THREAD_AUTODRIVE		0		// AUTODRIVE#<dev>_<ch>
+#define SDN_THREAD_SLEW				1		// HVSLEW#<dev>
+#define SDN_THREAD_GROUP			2		// RAMPGROUP#<n>
+#define SDN_THREAD_RECIPE			3		// RECIPE#<dev>
+#define SDN_THREAD_POLLER			4		// SDNPOLL_<port> of drvSCANDINOVA, SDNPOLL poll scheduler
+#define SDN_THREAD_CLASS_COUNT		5
+
+// actual - scheduled wakeup time of a periodic thread
+typedef struct
+{
+	int nWakeups;
+	double dbLast;					// (unit: sec)
+	double dbMax;
+	double dbSum;
+} SCANDINOVA_JITTER_INFO;
+
+epicsThreadId scandinovaThreadCreate(int nClass, const char *strName, unsigned int nPriority,
+		epicsThreadStackSizeClass stackSize, EPICSTHREADFUNC func, void *pParm);
+int scandinovaThreadConfigure(const char *strName, int nPriority, int nStackSize, const char *strCpus);
+
+void scandinovaJitterSample(SCANDINOVA_JITTER_INFO *pJitter, double dbScheduled, double dbActual);
+void scandinovaJitterReset(SCANDINOVA_JITTER_INFO *pJitter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * SCANDINOVA command write verification
+ *
+ * The modulator does not answer writes, so every state, hv and control word
+ * command is matched against its read back in the following ping frames.
+ * A command not shown within dbVerifyTimeout is written again up to
+ * nVerifyRetries times, then it is counted as failed. The latency is first
+ * write -> receive time of the frame that shows it. No EPICS dependency, the
+ * device support calls it from the port thread and scandinovaTest directly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "devSCANDINOVA.h"
+
+typedef struct
+{
+	int nPage;						// ping carrying the read back
+	int nMask;						// compared bits of a word, 0: analog
+	double dbTolerance;
+} VERIFY_CMD;
+
+// reset (bit 0) and master reset (bit 8) of the control word clear themselves
+static const VERIFY_CMD verifyCmd[SDN_VERIFY_COUNT] = {
+	{0,	0xFFFF,	0},
+	{0,	0,		SDN_VERIFY_HV_TOLERANCE},
+	{2,	0xFEFE,	0},
+};
+
+static double readBack(const SCANDINOVA_INFO *pInfo, int nCmd)
+{
+	switch(nCmd)
+	{
+		case SDN_VERIFY_STATE:		return pInfo->dbStateSet;
+		case SDN_VERIFY_HV:			return pInfo->dbHVPSVoltSet;
+		default:					return pInfo->dbControlWordSet;
+	}
+}
+
+static int isApplied(int nCmd, double dbValue, double dbReadBack)
+{
+	const VERIFY_CMD *pCmd = &verifyCmd[nCmd];
+
+	if(pCmd->nMask)
+		return (((int)dbValue ^ (int)dbReadBack) & pCmd->nMask) == 0;
+	return fabs(dbValue - dbReadBack) <= pCmd->dbTolerance;
+}
+
+// a command was written, the same value again keeps its first write time
+void scandinovaVerifyStart(SCANDINOVA_VERIFY_INFO *pVfy, double dbValue, double dbNow)
+{
+	if(pVfy->nStatus == SDN_VERIFY_PENDING && pVfy->dbValue == dbValue)
+	{
+		pVfy->dbLastSent = dbNow;
+		return;
+	}
+	pVfy->nStatus = SDN_VERIFY_PENDING;
+	pVfy->dbValue = dbValue;
+	pVfy->dbFirstSent = dbNow;
+	pVfy->dbLastSent = dbNow;
+	pVfy->nTries = 0;
+}
+
+/*
+ * A decoded ping: returns the commands (1 << SDN_VERIFY_xxx) to be written
+ * again, the caller writes them and calls scandinovaVerifyRetry.
+ */
+int scandinovaVerifyFrame(SCANDINOVA_INFO *pInfo, int nPage, double dbFrameTime)
+{
+	SCANDINOVA_VERIFY_INFO *pVfy;
+	int nResend = 0;
+	int i;
+
+	for(i=0;i!=SDN_VERIFY_COUNT;++i)
+	{
+		pVfy = &pInfo->VFY[i];
+		// frames received before the write cannot show it
+		if(verifyCmd[i].nPage != nPage || pVfy->nStatus != SDN_VERIFY_PENDING || dbFrameTime < pVfy->dbFirstSent)
+			continue;
+
+		if(isApplied(i,pVfy->dbValue,readBack(pInfo,i)))
+		{
+			pVfy->nStatus = SDN_VERIFY_APPLIED;
+			pVfy->dbLatency = dbFrameTime - pVfy->dbFirstSent;
+			pVfy->dbLatencyMax = fmax(pVfy->dbLatencyMax, pVfy->dbLatency);
+			++pVfy->nApplied;
+		}
+		else if(dbFrameTime - pVfy->dbLastSent >= pInfo->dbVerifyTimeout)
+		{
+			if(pVfy->nTries < pInfo->nVerifyRetries)
+				nResend |= 1 << i;
+			else
+			{
+				pVfy->nStatus = SDN_VERIFY_FAILED;
+				++pVfy->nFailed;
+			}
+		}
+	}
+	return nResend;
+}
+
+void scandinovaVerifyRetry(SCANDINOVA_VERIFY_INFO *pVfy, double dbNow)
+{
+	++pVfy->nTries;
+	++pVfy->nRetries;
+	pVfy->dbLastSent = dbNow;
+}
+
+// counters and latency, a pending command stays pending
+void scandinovaVerifyReset(SCANDINOVA_VERIFY_INFO *pVfy)
+{
+	pVfy->dbLatency = 0;
+	pVfy->dbLatencyMax = 0;
+	pVfy->nApplied = 0;
+	pVfy->nRetries = 0;
+	pVfy->nFailed = 0;
+}